@@ -1,5 +1,10 @@
 set(SOURCES
     common/config.h
+    common/ring_buffer.h
+    common/fixed_point.h
+    common/bounded_sample.h
+    common/sample_clock.h
+    common/intr_stamp.h
 
     core/info.h
     core/event_manager.h
@@ -8,10 +13,12 @@ set(SOURCES
     core/sntp.c
     core/ota.h
     core/ota.cpp
+    core/result_channel.h
 
     peripherals/gpio.h
     peripherals/gpio.cpp
     peripherals/i2c.h
+    peripherals/i2c_queue.h
     peripherals/i2c.cpp
     peripherals/spi.h
     peripherals/spi.cpp
@@ -20,11 +27,42 @@ set(SOURCES
     network/wifi/wifi.cpp
     protocols/mqtt/mqtt.h
     protocols/mqtt/mqtt.cpp
+    protocols/mqtt/waveform_frame.h
+    protocols/mqtt/waveform_stream.h
+    protocols/mqtt/waveform_stream.cpp
+    protocols/mqtt/fall_alert.h
+    protocols/mqtt/fall_alert.cpp
 
     devices/max30102/max30102.h
     devices/max30102/max30102.cpp
+    devices/max30102/beat_detector.h
+    devices/max30102/beat_detector.cpp
+    devices/max30102/led_agc.h
+    devices/max30102/led_agc.cpp
+    devices/max30102/spo2.h
+    devices/max30102/biquad.h
+    devices/max30102/acquisition_profile.h
+    devices/max30102/motion_canceller.h
+    devices/max30102/signal_quality.h
+    devices/max30102/signal_quality.cpp
+    devices/max30102/hrv.h
+    devices/max30102/hrv.cpp
+    devices/max30102/spectral_hr.h
+    devices/max30102/finger_presence.h
+    devices/max30102/ppg_processor.h
+    devices/max30102/ppg_processor.cpp
     devices/mpu6050/mpu6050.h
     devices/mpu6050/mpu6050.cpp
+    devices/mpu6050/imu_range.h
+    devices/mpu6050/motion_history.h
+    devices/mpu6050/activity.h
+    devices/mpu6050/activity.cpp
+    devices/mpu6050/fall_detector.h
+    devices/mpu6050/fall_detector.cpp
+    devices/mpu6050/attitude.h
+    devices/mpu6050/attitude.cpp
+    devices/mpu6050/imu_calibration.h
+    devices/mpu6050/imu_calibration.cpp
     devices/oled/sh1106.h
     devices/oled/sh1106.cpp
 )
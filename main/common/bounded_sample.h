@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace common {
+    // Up to N values in a fixed array (no heap, fine on the stack) with order statistics by nth_element,
+    // O(n) per query. Queries reorder the stored values. Pushes beyond N are dropped and counted.
+    template <typename T, size_t N>
+    class BoundedSample {
+    public:
+        bool push(T value) {
+            if (size_ == N) {
+                dropped_++;
+                return false;
+            }
+            values_[size_++] = value;
+            return true;
+        }
+
+        void clear() {
+            size_ = 0;
+            dropped_ = 0;
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        size_t dropped() const { return dropped_; }
+        static constexpr size_t capacity() { return N; }
+
+        // Mean of the two middle values for an even count; empty() must be false
+        T median() {
+            size_t mid = size_ / 2;
+            std::nth_element(values_, values_ + mid, values_ + size_);
+            if (size_ & 1) return values_[mid];
+
+            T lower = *std::max_element(values_, values_ + mid);
+            return (lower + values_[mid]) / 2;
+        }
+
+        // Mean after dropping round(size * trim) values at each end, at least one value is kept;
+        // trim = 0.25 is the interquartile mean. empty() must be false
+        T trimmed_mean(float trim) {
+            size_t k = std::min(static_cast<size_t>(size_ * trim + 0.5f), (size_ - 1) / 2);
+            if (k) {
+                std::nth_element(values_, values_ + k, values_ + size_);
+                std::nth_element(values_ + k, values_ + size_ - k - 1, values_ + size_);
+            }
+
+            T sum = 0;
+            for (size_t i = k; i < size_ - k; i++) sum += values_[i];
+            return sum / static_cast<T>(size_ - 2 * k);
+        }
+
+    private:
+        T values_[N];
+        size_t size_ = 0;
+        size_t dropped_ = 0;
+
+    }; // class BoundedSample
+
+} // namespace common
@@ -28,6 +28,8 @@ enum class EnableLog {
 #define I2C_BUS_1 I2C_NUM_1
 #define SCL_PIN GPIO_NUM_21
 #define SDA_PIN GPIO_NUM_22
+#define SCL_PIN_1 GPIO_NUM_25
+#define SDA_PIN_1 GPIO_NUM_26
 
 // SPI
 #define SPI_HOST_0 SPI2_HOST
@@ -38,12 +40,19 @@ enum class EnableLog {
 
 // MAX30102
 #define MAX30102_INTR GPIO_NUM_23
+#define MAX30102_INTR_1 GPIO_NUM_19     // Second sensor on I2C_BUS_1
 #define MAX30102_ADDRESS 0x57
 #define MAX30102_FREQ_HZ 100000
+#define VITALS_QUALITY_MIN 50           // Signal quality score (0 - 100) below which readings are not published
+#define MAX30102_SPO2_FIXED_POINT 1     // 0: float SpO2 pipeline
+#define MAX30102_FILTER_FIXED_POINT 1   // 0: float band-pass filter
+#define MAX30102_ABSENCE_TIMEOUT_MS 5000    // No finger for this long: sensor shut down, presence probed once a second
 
 // MPU6050
 #define MPU6050_ADDRESS 0x68
 #define MPU6050_FREQ_HZ 100000
+#define MPU6050_INTR GPIO_NUM_4
+#define MPU6050_WAKE_ON_MOTION 1        // 0: full-rate acquisition all the time
 
 // SH1106
 #define SH1106_CS GPIO_NUM_15
@@ -72,9 +81,32 @@ enum class EnableLog {
     // {
     //     "id": "000000",
     //     "bpm": "0",
-    //     "spo2": "0.0"
+    //     "spo2": "0.0",
+    //     "quality": "0",
+    //     "posture": "upright",   // "upright", "sitting", "lying"
+    //     "rmssd": "0.0",         // HRV fields (ms, ms, %) only in the first message after each HRV period
+    //     "sdnn": "0.0",
+    //     "pnn50": "0.0"
     // }
     #define TOPIC_CENTER_SENSOR "center/data_sensor_1"
+    // Once a minute, activity is the most frequent of "rest", "walk", "run"
+    // {
+    //     "id": "000000",
+    //     "steps": "0",
+    //     "total_steps": "0",
+    //     "activity": "rest"
+    // }
+    #define TOPIC_CENTER_ACTIVITY "center/activity_1"
+    // QoS 1, sent as soon as a fall is confirmed, ahead of all other messages
+    // {
+    //     "id": "000000",
+    //     "impact": "0.0",        // g
+    //     "free_fall": "0",       // ms
+    //     "detect_ms": "0"        // Impact to detection
+    // }
+    #define TOPIC_CENTER_ALERT "center/alert_1"
+    // Binary raw PPG frames (protocols/mqtt/waveform_frame.h), topic ends with the Wi-Fi STA MAC in hex
+    #define TOPIC_CENTER_WAVEFORM "center/waveform/"
 
     // Subscriber 1
     // {
@@ -98,11 +130,28 @@ enum class EnableLog {
     //     "url": "https://github.com/ChopChop-Terabyte/firmware_ota/releases/download/firdmware_esp32/tb_deo_error.bin"
     // }
     #define TOPIC_CLIENT_OTA "client/ota"
+    // {
+    //     "enable": "1"
+    // }
+    #define TOPIC_CLIENT_WAVEFORM "client/waveform"
+    // Any payload: recalibrate the MPU6050 on the next stationary window
+    #define TOPIC_CLIENT_CALIBRATE "client/calibrate"
 
     #define PING "ping"
     #define ID "id"
     #define BPM "bpm"
     #define SPO2 "spo2"
+    #define QUALITY "quality"
+    #define RMSSD "rmssd"
+    #define SDNN "sdnn"
+    #define PNN50 "pnn50"
+    #define POSTURE "posture"
+    #define STEPS "steps"
+    #define TOTAL_STEPS "total_steps"
+    #define ACTIVITY "activity"
+    #define ALERT_IMPACT "impact"
+    #define ALERT_FREE_FALL "free_fall"
+    #define ALERT_DETECT_MS "detect_ms"
     #define NAME "name"
     #define GENDER "gender"
     #define AGE "age"
@@ -110,5 +159,6 @@ enum class EnableLog {
     #define HEIGHT "height"
     #define NOTICE "notice"
     #define URL "url"
+    #define ENABLE "enable"
 
 /* End MQTT config */
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+namespace common {
+    // Signed Q(31-FRAC).FRAC value on int32_t, 64-bit intermediates for * and /.
+    template <int FRAC>
+    class Fixed {
+    public:
+        static_assert(FRAC > 0 && FRAC < 31, "Fixed needs 1..30 fractional bits");
+        static constexpr int32_t ONE = int32_t(1) << FRAC;
+
+        constexpr Fixed() = default;
+        constexpr Fixed(int value) : raw_(value * ONE) {}
+        constexpr Fixed(float value) : raw_(static_cast<int32_t>(value * ONE + (value < 0 ? -0.5f : 0.5f))) {}
+
+        static constexpr Fixed from_raw(int32_t raw) {
+            Fixed f;
+            f.raw_ = raw;
+            return f;
+        }
+
+        // num / den straight from integers, without an intermediate Fixed for num or den
+        static constexpr Fixed from_ratio(int64_t num, int64_t den) {
+            return from_raw(static_cast<int32_t>((num * ONE) / den));
+        }
+
+        constexpr int32_t raw() const { return raw_; }
+        constexpr float to_float() const { return static_cast<float>(raw_) / ONE; }
+        constexpr int to_int() const { return raw_ >> FRAC; }     // floor
+
+        constexpr Fixed operator+(Fixed o) const { return from_raw(raw_ + o.raw_); }
+        constexpr Fixed operator-(Fixed o) const { return from_raw(raw_ - o.raw_); }
+        constexpr Fixed operator-() const { return from_raw(-raw_); }
+        constexpr Fixed operator*(Fixed o) const { return from_raw(static_cast<int32_t>((int64_t(raw_) * o.raw_) >> FRAC)); }
+        constexpr Fixed operator/(Fixed o) const { return from_raw(static_cast<int32_t>((int64_t(raw_) << FRAC) / o.raw_)); }
+        constexpr Fixed &operator+=(Fixed o) { raw_ += o.raw_; return *this; }
+        constexpr Fixed &operator-=(Fixed o) { raw_ -= o.raw_; return *this; }
+        constexpr Fixed &operator*=(Fixed o) { return *this = *this * o; }
+
+        constexpr bool operator<(Fixed o) const { return raw_ < o.raw_; }
+        constexpr bool operator>(Fixed o) const { return raw_ > o.raw_; }
+        constexpr bool operator<=(Fixed o) const { return raw_ <= o.raw_; }
+        constexpr bool operator>=(Fixed o) const { return raw_ >= o.raw_; }
+        constexpr bool operator==(Fixed o) const { return raw_ == o.raw_; }
+
+    private:
+        int32_t raw_ = 0;
+
+    }; // class Fixed
+
+    // Same helpers for float so templates can be written once for both
+    template <typename T>
+    constexpr T from_ratio(int64_t num, int64_t den) {
+        if constexpr (std::is_floating_point_v<T>) return static_cast<T>(num) / static_cast<T>(den);
+        else return T::from_ratio(num, den);
+    }
+
+    template <typename T>
+    constexpr float to_float(T value) {
+        if constexpr (std::is_floating_point_v<T>) return static_cast<float>(value);
+        else return value.to_float();
+    }
+
+    template <typename T>
+    constexpr int to_int(T value) {
+        if constexpr (std::is_floating_point_v<T>) return static_cast<int>(value);
+        else return value.to_int();
+    }
+
+} // namespace common
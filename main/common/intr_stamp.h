@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace common {
+    // Timestamp and count of an interrupt, written by its ISR and read by one task. The 64-bit time is two
+    // 32-bit stores on the ESP32, so it sits behind a sequence that is odd while the ISR writes; a reader
+    // retries on an odd or changed sequence and never sees a torn time or a time from another pulse.
+    class IntrStamp {
+    public:
+        // ISR side, returns the count including this interrupt
+        uint32_t record(int64_t time_us) {
+            uint32_t seq = seq_.load(std::memory_order_relaxed);
+            seq_.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            time_us_ = time_us;
+            uint32_t count = count_.load(std::memory_order_relaxed) + 1;
+            count_.store(count, std::memory_order_relaxed);
+            seq_.store(seq + 2, std::memory_order_release);
+            return count;
+        }
+
+        // Time of the latest interrupt and the number so far
+        int64_t read(uint32_t &count) const {
+            uint32_t begin;
+            int64_t time_us;
+            do {
+                begin = seq_.load(std::memory_order_acquire);
+                time_us = time_us_;
+                count = count_.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while ((begin & 1) || begin != seq_.load(std::memory_order_relaxed));
+            return time_us;
+        }
+
+        uint32_t count() const {
+            uint32_t count;
+            read(count);
+            return count;
+        }
+
+    private:
+        std::atomic<uint32_t> seq_{0};
+        volatile int64_t time_us_ = 0;          // Not lock-free as an atomic on the ESP32, the sequence guards it
+        std::atomic<uint32_t> count_{0};
+
+    }; // class IntrStamp
+
+} // namespace common
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace common {
+    // Fixed-capacity ring buffer, no heap. Every element is stored twice (at i and i + N)
+    // so the live window is always contiguous and can be handed out as a span.
+    template <typename T, size_t N>
+    class RingBuffer {
+    public:
+        static_assert(N > 0, "RingBuffer capacity must be non-zero");
+
+        void push(const T &value) {
+            size_t pos = tail_ + size_;
+            if (pos >= N) pos -= N;
+
+            buf_[pos] = value;
+            buf_[pos + N] = value;
+
+            if (size_ < N) size_++;
+            else if (++tail_ == N) tail_ = 0;
+        }
+
+        void clear() {
+            tail_ = 0;
+            size_ = 0;
+        }
+
+        std::span<const T> view() const { return {&buf_[tail_], size_}; }
+        const T &operator[](size_t i) const { return buf_[tail_ + i]; }
+        const T &back() const { return buf_[tail_ + size_ - 1]; }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        bool full() const { return size_ == N; }
+        static constexpr size_t capacity() { return N; }
+
+    private:
+        T buf_[2 * N] = {};
+        size_t tail_ = 0;
+        size_t size_ = 0;
+
+    }; // class RingBuffer
+
+} // namespace common
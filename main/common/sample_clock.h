@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace common {
+    // Sample-index timebase for FIFO batches: sample i of a batch is at first + i * period, where first follows on
+    // from the previous batch and the interrupt timestamp only nudges phase and period. Task scheduling delays
+    // therefore never reach the sample times, ISR latency jitter is averaged out, and the loop follows the
+    // sensor oscillator's deviation from the nominal rate. Times are kept in 1/65536 us.
+    class SampleClock {
+    public:
+        static constexpr int FRAC = 16;
+        static constexpr int64_t PHASE_DIV = 8;         // Share of the timestamp error applied to the phase per batch
+        static constexpr int64_t FREQ_DIV = 32;         // ... and to the period, spread over the batch
+        static constexpr int64_t MAX_DRIFT_DIV = 20;    // Period kept within nominal +-5 %
+        static constexpr int64_t MAX_STEP_DIV = 16;     // Timestamp errors clamped to period / 16 before the loop
+        static constexpr int64_t RESYNC_PERIODS = 2;    // Larger errors (lost samples, stalls) restart from the timestamp
+
+        void restart(int64_t period_us) {
+            nominal_ = period_us << FRAC;
+            period_ = nominal_;
+            synced_ = false;
+        }
+
+        // Starts a batch of count samples. Sample ref was the newest one when the interrupt at isr_us fired;
+        // isr_us = 0 when there is no timestamp for the batch. lost: the FIFO overflowed before this batch.
+        void batch(int64_t isr_us, size_t count, size_t ref, bool lost) {
+            if (isr_us && (!synced_ || lost)) {
+                anchor(isr_us, ref);
+            } else if (isr_us) {
+                int64_t error = (isr_us << FRAC) - (next_ + static_cast<int64_t>(ref) * period_);
+                if (error > RESYNC_PERIODS * period_ || error < -RESYNC_PERIODS * period_) {
+                    anchor(isr_us, ref);
+                } else {
+                    // A late stamp (ISR held off) moves the estimate by a bounded step only
+                    int64_t max_step = period_ / MAX_STEP_DIV;
+                    if (error > max_step) error = max_step;
+                    if (error < -max_step) error = -max_step;
+                    first_ = next_ + error / PHASE_DIV;
+                    period_ += error / (FREQ_DIV * static_cast<int64_t>(count ? count : 1));
+                    int64_t max_drift = nominal_ / MAX_DRIFT_DIV;
+                    if (period_ > nominal_ + max_drift) period_ = nominal_ + max_drift;
+                    if (period_ < nominal_ - max_drift) period_ = nominal_ - max_drift;
+                }
+            } else {
+                first_ = next_;
+            }
+            next_ = first_ + static_cast<int64_t>(count) * period_;
+        }
+
+        int64_t time(size_t index) const { return (first_ + static_cast<int64_t>(index) * period_) >> FRAC; }
+        bool synced() const { return synced_; }
+        int64_t period_us() const { return period_ >> FRAC; }
+
+    private:
+        void anchor(int64_t isr_us, size_t ref) {
+            first_ = (isr_us << FRAC) - static_cast<int64_t>(ref) * period_;
+            synced_ = true;
+        }
+
+        int64_t nominal_ = 0;
+        int64_t period_ = 0;
+        int64_t first_ = 0;         // First sample of the current batch
+        int64_t next_ = 0;          // Expected first sample of the next batch
+        bool synced_ = false;
+
+    }; // class SampleClock
+
+} // namespace common
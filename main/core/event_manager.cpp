@@ -7,7 +7,7 @@ namespace core {
 
     void EventManager::init() {
         queue_ = xQueueCreate(queue_length_, sizeof(mess_t));
-        queue_intr_ = xQueueCreate(queue_length_, sizeof(mess_intr_t));
+        queue_intr_ = xQueueCreate(INTR_QUEUE_LENGTH, sizeof(mess_intr_t));
     }
 
     void EventManager::start() {
@@ -86,4 +86,12 @@ namespace core {
         portYIELD_FROM_ISR(hpw);
     }
 
+    // Task context: ahead of everything already queued on the highest priority event task
+    bool EventManager::publish_priority(EventID id, int data, TickType_t timeout) {
+        if (!queue_intr_) return false;
+
+        mess_intr_t ev{id, data};
+        return xQueueSendToFront(queue_intr_, &ev, timeout) == pdTRUE;
+    }
+
 } // namespace core
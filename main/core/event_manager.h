@@ -19,7 +19,11 @@ namespace core {
         NET_STATUS,
         BUZZER,
         MAX30102,
-        OTA
+        OTA,
+        WAVEFORM,
+        FINGER_PRESENCE,        // publish_intr, data: Presence
+        FALL,                   // publish_priority, data: impact in milli-g
+        IMU_CALIBRATE           // publish_intr
     };
 
     typedef struct {
@@ -52,8 +56,11 @@ namespace core {
         void publish(EventID id, void *data = nullptr);
         void subscribe_intr(EventID id, intr_callback intr_callback_ev);
         void publish_intr(EventID id, int data = 0);
+        bool publish_priority(EventID id, int data = 0, TickType_t timeout = 0);
 
     private:
+        static constexpr uint8_t INTR_QUEUE_LENGTH = 4;     // Room for a priority event behind a slow callback
+
         EventManager(uint8_t queue_length = 1);
 
         uint8_t queue_length_;
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace core {
+    // Single producer, many readers, lock-free latest-value channel (seqlock).
+    // Each reader keeps its own sequence number; wait() blocks on the task notification
+    // of the calling task, so readers should not use task notifications for anything else.
+    template <typename T, size_t MAX_READERS = 4>
+    class ResultChannel {
+    public:
+        static_assert(std::is_trivially_copyable_v<T>, "ResultChannel needs a trivially copyable record");
+
+        void publish(const T &value) {
+            uint32_t words[WORDS] = {};
+            memcpy(words, &value, sizeof(T));
+
+            uint32_t seq = seq_.load(std::memory_order_relaxed);
+            seq_.store(seq + 1, std::memory_order_relaxed);         // Odd: write in progress
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < WORDS; i++) data_[i].store(words[i], std::memory_order_relaxed);
+            seq_.store(seq + 2, std::memory_order_release);
+
+            for (auto &reader : readers_) {
+                TaskHandle_t task = reader.load(std::memory_order_acquire);
+                if (task) xTaskNotifyGive(task);
+            }
+        }
+
+        // True and fills out when a record newer than last_seq exists, then advances last_seq
+        bool read(T &out, uint32_t &last_seq) const {
+            uint32_t words[WORDS];
+            uint32_t begin, end;
+
+            do {
+                begin = seq_.load(std::memory_order_acquire);
+                if (begin == last_seq) return false;
+                for (size_t i = 0; i < WORDS; i++) words[i] = data_[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                end = seq_.load(std::memory_order_relaxed);
+            } while ((begin & 1) || begin != end);
+
+            memcpy(&out, words, sizeof(T));
+            last_seq = begin;
+            return true;
+        }
+
+        // Registers the task for publish notifications; false when MAX_READERS tasks already are, wait() then
+        // only returns on its timeout. wait() subscribes on its own, call this first to catch the failure.
+        bool subscribe(TaskHandle_t task = xTaskGetCurrentTaskHandle()) {
+            for (auto &reader : readers_) {
+                if (reader.load(std::memory_order_relaxed) == task) return true;
+            }
+            for (auto &reader : readers_) {
+                TaskHandle_t empty = nullptr;
+                if (reader.compare_exchange_strong(empty, task, std::memory_order_release)) return true;
+            }
+            return false;
+        }
+
+        bool wait(T &out, uint32_t &last_seq, TickType_t timeout) {
+            subscribe(xTaskGetCurrentTaskHandle());
+            TickType_t start = xTaskGetTickCount();
+
+            // A stale notification from an already-read record only costs one extra loop
+            while (!read(out, last_seq)) {
+                TickType_t elapsed = xTaskGetTickCount() - start;
+                if (elapsed >= timeout || !ulTaskNotifyTake(pdTRUE, timeout - elapsed)) return read(out, last_seq);
+            }
+            return true;
+        }
+
+    private:
+        static constexpr size_t WORDS = (sizeof(T) + 3) / 4;
+
+        std::atomic<uint32_t> seq_{0};
+        std::atomic<uint32_t> data_[WORDS] = {};
+        std::atomic<TaskHandle_t> readers_[MAX_READERS] = {};
+
+    }; // class ResultChannel
+
+} // namespace core
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace devices {
+    enum class AcquisitionProfile {
+        LOW_POWER = 0,      // 50 sps, short pulses: least LED energy
+        STANDARD,           // 100 sps
+        HIGH_RESOLUTION     // 400 sps, 4x the effective rate
+    };
+
+    // Register values of each profile and the processing constants that depend on the effective sample rate.
+    // SPO2_SCALE_CONFIG: [6:5] ADC range, [4:2] sample rate, [1:0] LED pulse width.
+    // FIFO_CONFIG: [7:5] sample averaging, [4] rollover, [3:0] free slots left at almost-full (15 -> 17 unread samples).
+    // The ADC range stays at 8192 nA everywhere so DC levels (finger detection, LED AGC) keep the same scale.
+    template <AcquisitionProfile P>
+    struct ProfileTraits;
+
+    template <>
+    struct ProfileTraits<AcquisitionProfile::LOW_POWER> {
+        static constexpr uint8_t SPO2_CONFIG = 0x42;            // 8192 nA, 50 sps, 215 us (17 bit)
+        static constexpr uint8_t FIFO_CONFIG = 0x5F;            // 4 samples averaging, rollover, almost full at 17
+        static constexpr float SAMPLE_RATE_HZ = 12.5f;          // After averaging
+        static constexpr int WINDOW_MS = 15000;                 // Longer window against the lower SNR
+        static constexpr size_t MAX_CACHE_SIZE = 200;
+        static constexpr int EXTREMUM_RADIUS = 2;               // Samples each side of a peak / trough (160 ms)
+        static constexpr size_t BEAT_SMOOTHING = 1;             // Moving average ahead of the BeatDetector
+        static constexpr size_t MOTION_TAPS = 3;                // Accelerometer history per axis in the canceller (240 ms)
+        static constexpr size_t SPECTRAL_SIZE = 512;            // FFT points of the spectral engine, 1.5 bpm bins at 12.5 sps
+        static constexpr size_t SPECTRAL_DECIMATION = 1;        // Samples averaged per FFT input
+    };
+
+    template <>
+    struct ProfileTraits<AcquisitionProfile::STANDARD> {
+        static constexpr uint8_t SPO2_CONFIG = 0x47;            // 8192 nA, 100 sps, 411 us (18 bit)
+        static constexpr uint8_t FIFO_CONFIG = 0x7F;            // 8 samples averaging, rollover, almost full at 17
+        static constexpr float SAMPLE_RATE_HZ = 12.5f;
+        static constexpr int WINDOW_MS = 10000;
+        static constexpr size_t MAX_CACHE_SIZE = 200;
+        static constexpr int EXTREMUM_RADIUS = 2;
+        static constexpr size_t BEAT_SMOOTHING = 1;
+        static constexpr size_t MOTION_TAPS = 3;
+        static constexpr size_t SPECTRAL_SIZE = 512;
+        static constexpr size_t SPECTRAL_DECIMATION = 1;
+    };
+
+    template <>
+    struct ProfileTraits<AcquisitionProfile::HIGH_RESOLUTION> {
+        static constexpr uint8_t SPO2_CONFIG = 0x4F;            // 8192 nA, 400 sps, 411 us (18 bit)
+        static constexpr uint8_t FIFO_CONFIG = 0x7F;            // 8 samples averaging, rollover, almost full at 17
+        static constexpr float SAMPLE_RATE_HZ = 50.0f;
+        static constexpr int WINDOW_MS = 5000;                  // Faster updates, still ~250 samples per window
+        static constexpr size_t MAX_CACHE_SIZE = 320;
+        static constexpr int EXTREMUM_RADIUS = 8;
+        static constexpr size_t BEAT_SMOOTHING = 4;             // 80 ms, keeps noise from forming local maxima
+        static constexpr size_t MOTION_TAPS = 8;                // 160 ms
+        static constexpr size_t SPECTRAL_SIZE = 512;
+        static constexpr size_t SPECTRAL_DECIMATION = 4;        // Down to 12.5 sps, the band-pass already ends at 4 Hz
+    };
+
+    // Runtime view of the traits for the driver side
+    struct ProfileConfig {
+        uint8_t spo2_config;
+        uint8_t fifo_config;
+        float sample_rate_hz;
+        int64_t sample_period_us;
+        int window_ms;
+    };
+
+    template <AcquisitionProfile P>
+    constexpr ProfileConfig make_profile_config() {
+        using Traits = ProfileTraits<P>;
+        return {Traits::SPO2_CONFIG, Traits::FIFO_CONFIG, Traits::SAMPLE_RATE_HZ,
+                static_cast<int64_t>(1000000 / Traits::SAMPLE_RATE_HZ), Traits::WINDOW_MS};
+    }
+
+    constexpr ProfileConfig profile_config(AcquisitionProfile profile) {
+        switch (profile) {
+            case AcquisitionProfile::LOW_POWER: return make_profile_config<AcquisitionProfile::LOW_POWER>();
+            case AcquisitionProfile::HIGH_RESOLUTION: return make_profile_config<AcquisitionProfile::HIGH_RESOLUTION>();
+            default: return make_profile_config<AcquisitionProfile::STANDARD>();
+        }
+    }
+
+    constexpr const char *profile_name(AcquisitionProfile profile) {
+        switch (profile) {
+            case AcquisitionProfile::LOW_POWER: return "low-power";
+            case AcquisitionProfile::HIGH_RESOLUTION: return "high-resolution";
+            default: return "standard";
+        }
+    }
+
+} // namespace devices
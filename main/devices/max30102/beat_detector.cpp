@@ -0,0 +1,86 @@
+#include "beat_detector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace devices {
+    BeatDetector::BeatDetector(float sample_rate_hz)
+                    : dc_alpha_(1.0f / (1.5f * sample_rate_hz)),
+                    amp_decay_(1.0f - 1.0f / (AMP_DECAY_S * sample_rate_hz)),
+                    warmup_(static_cast<uint32_t>(2 * sample_rate_hz)) {}
+
+    void BeatDetector::reset() {
+        dc_ = 0;
+        prev_ac_ = 0;
+        prev_prev_ac_ = 0;
+        prev_time_us_ = 0;
+        trough_ = 0;
+        amp_avg_ = 0;
+        samples_ = 0;
+
+        interval_sum_ = 0;
+        interval_pos_ = 0;
+        interval_count_ = 0;
+
+        bpm_ = 0;
+        last_beat_ = {};
+    }
+
+    bool BeatDetector::update(uint32_t sample, int64_t time_us) {
+        if (!samples_++) dc_ = sample;
+        dc_ += dc_alpha_ * (sample - dc_);
+        float ac = sample - dc_;
+        bool beat = false;
+
+        if (samples_ <= warmup_) {
+            // Let the DC estimate settle and seed the threshold with the largest swing seen
+            amp_avg_ = std::max(amp_avg_, ac - trough_);
+        } else if (prev_ac_ > ac && prev_ac_ >= prev_prev_ac_) {
+            float amp = prev_ac_ - trough_;
+            int64_t peak_us = prev_time_us_ + peak_offset(prev_prev_ac_, prev_ac_, ac, time_us - prev_time_us_);
+            int64_t interval = last_beat_.time_us ? peak_us - last_beat_.time_us : 0;
+
+            if (amp > THRESHOLD_RATIO * amp_avg_ && (!interval || interval >= MIN_INTERVAL_US)) {
+                beat = true;
+                amp_avg_ = 0.75f * amp_avg_ + 0.25f * amp;
+                trough_ = ac;
+
+                if (interval > MAX_INTERVAL_US) {
+                    interval_sum_ = 0;
+                    interval_pos_ = 0;
+                    interval_count_ = 0;
+                    interval = 0;
+                    bpm_ = 0;
+                } else if (interval) {
+                    if (interval_count_ == INTERVALS) interval_sum_ -= intervals_[interval_pos_];
+                    else interval_count_++;
+
+                    intervals_[interval_pos_] = interval;
+                    interval_sum_ += interval;
+                    if (++interval_pos_ == INTERVALS) interval_pos_ = 0;
+
+                    bpm_ = static_cast<int>(60LL * 1000000 * interval_count_ / interval_sum_);
+                }
+
+                last_beat_ = {peak_us, interval, bpm_};
+            }
+        }
+
+        trough_ = std::min(trough_, ac);
+        amp_avg_ *= amp_decay_;
+
+        prev_prev_ac_ = prev_ac_;
+        prev_ac_ = ac;
+        prev_time_us_ = time_us;
+
+        return beat;
+    }
+
+    int64_t BeatDetector::peak_offset(float before, float peak, float after, int64_t period_us) {
+        // Vertex of the parabola through the three samples, within half a sample of the middle one
+        float curvature = before - 2 * peak + after;
+        if (curvature >= 0) return 0;
+        float offset = std::clamp(0.5f * (before - after) / curvature, -0.5f, 0.5f);
+        return static_cast<int64_t>(std::lround(offset * period_us));
+    }
+
+} // namespace devices
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace devices {
+    struct BeatEvent {
+        int64_t time_us;        // Timestamp of the detected peak, interpolated between samples
+        int64_t interval_us;    // Time since the previous beat, 0 for the first beat
+        int bpm;                // Rolling heart rate after this beat
+    };
+
+    // Incremental peak detector, O(1) time and memory per sample:
+    // DC tracking -> peak-to-trough amplitude check against an adaptive threshold -> refractory gate.
+    // Peak times are interpolated between samples, at 12.5 sps a whole sample is 80 ms of RR interval.
+    class BeatDetector {
+    public:
+        explicit BeatDetector(float sample_rate_hz);
+
+        bool update(uint32_t sample, int64_t time_us);
+        void reset();
+        void shift(float delta) { dc_ += delta; }     // Input level stepped by delta (LED current change)
+
+        const BeatEvent &last_beat() const { return last_beat_; }
+        int get_heart_rate() const { return bpm_; }
+
+    private:
+        static int64_t peak_offset(float before, float peak, float after, int64_t period_us);
+
+        static constexpr size_t INTERVALS = 8;                  // Beats in the rolling BPM average
+        static constexpr int64_t MIN_INTERVAL_US = 272000;      // 220 bpm
+        static constexpr int64_t MAX_INTERVAL_US = 2000000;     // 30 bpm, longer gaps restart the average
+        static constexpr float THRESHOLD_RATIO = 0.5f;          // Of the average beat amplitude
+        static constexpr float AMP_DECAY_S = 3.0f;              // Threshold decay time constant
+
+        float dc_alpha_;
+        float amp_decay_;
+        uint32_t warmup_;
+
+        float dc_ = 0;
+        float prev_ac_ = 0;
+        float prev_prev_ac_ = 0;
+        int64_t prev_time_us_ = 0;
+        float trough_ = 0;
+        float amp_avg_ = 0;
+        uint32_t samples_ = 0;
+
+        int64_t intervals_[INTERVALS] = {};
+        int64_t interval_sum_ = 0;
+        size_t interval_pos_ = 0;
+        size_t interval_count_ = 0;
+
+        int bpm_ = 0;
+        BeatEvent last_beat_ = {};
+
+    }; // class BeatDetector
+
+} // namespace devices
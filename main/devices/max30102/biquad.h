@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+namespace devices {
+    // Normalized biquad, a0 = 1
+    struct Biquad {
+        float b0, b1, b2;
+        float a1, a2;
+    };
+
+    namespace biquad_design {
+        constexpr double PI = 3.14159265358979323846;
+
+        // std::sin / std::cos are not constexpr, w0 is always within [0, pi]
+        constexpr double sin(double x) {
+            double term = x, sum = x;
+            for (int n = 1; n < 12; n++) {
+                term *= -x * x / ((2 * n) * (2 * n + 1));
+                sum += term;
+            }
+            return sum;
+        }
+
+        constexpr double cos(double x) {
+            double term = 1, sum = 1;
+            for (int n = 1; n < 12; n++) {
+                term *= -x * x / ((2 * n - 1) * (2 * n));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // y[n] = x[n] - x[n-1] + R * y[n-1]
+        constexpr Biquad dc_blocker(double fs, double fc) {
+            double r = 1 - 2 * PI * fc / fs;
+            return {1, -1, 0, static_cast<float>(-r), 0};
+        }
+
+        // RBJ cookbook, Q = 1/sqrt(2) (Butterworth)
+        constexpr Biquad highpass(double fs, double fc) {
+            double w0 = 2 * PI * fc / fs;
+            double c = cos(w0), alpha = sin(w0) / (2 * 0.70710678118654752);
+            double a0 = 1 + alpha;
+            return {static_cast<float>((1 + c) / 2 / a0), static_cast<float>(-(1 + c) / a0), static_cast<float>((1 + c) / 2 / a0),
+                    static_cast<float>(-2 * c / a0), static_cast<float>((1 - alpha) / a0)};
+        }
+
+        constexpr Biquad lowpass(double fs, double fc) {
+            double w0 = 2 * PI * fc / fs;
+            double c = cos(w0), alpha = sin(w0) / (2 * 0.70710678118654752);
+            double a0 = 1 + alpha;
+            return {static_cast<float>((1 - c) / 2 / a0), static_cast<float>((1 - c) / a0), static_cast<float>((1 - c) / 2 / a0),
+                    static_cast<float>(-2 * c / a0), static_cast<float>((1 - alpha) / a0)};
+        }
+
+    } // namespace biquad_design
+
+    // DC removal, then a 0.5 - 4 Hz band-pass
+    constexpr std::array<Biquad, 3> ppg_bandpass(double fs) {
+        return {biquad_design::dc_blocker(fs, 0.2), biquad_design::highpass(fs, 0.5), biquad_design::lowpass(fs, 4.0)};
+    }
+
+    // Direct Form II transposed cascade.
+    // float: plain float math.
+    // int32_t: Q3.28 coefficients, states kept at coefficient scale in int64_t so only the output is rounded.
+    template <typename T, size_t N>
+    class BiquadCascade {
+    public:
+        static_assert(std::is_same_v<T, float> || std::is_same_v<T, int32_t>, "BiquadCascade supports float or int32_t");
+        static constexpr int COEFF_FRAC = 28;
+
+        using coeff_t = std::conditional_t<std::is_same_v<T, float>, float, int32_t>;
+        using state_t = std::conditional_t<std::is_same_v<T, float>, float, int64_t>;
+
+        constexpr explicit BiquadCascade(const std::array<Biquad, N> &stages) {
+            for (size_t i = 0; i < N; i++) {
+                coeff_[i][0] = to_coeff(stages[i].b0);
+                coeff_[i][1] = to_coeff(stages[i].b1);
+                coeff_[i][2] = to_coeff(stages[i].b2);
+                coeff_[i][3] = to_coeff(stages[i].a1);
+                coeff_[i][4] = to_coeff(stages[i].a2);
+            }
+        }
+
+        T process(T x) {
+            for (size_t i = 0; i < N; i++) {
+                const coeff_t *c = coeff_[i];
+                state_t *s = state_[i];
+
+                if constexpr (std::is_same_v<T, float>) {
+                    float y = c[0] * x + s[0];
+                    s[0] = c[1] * x - c[3] * y + s[1];
+                    s[1] = c[2] * x - c[4] * y;
+                    x = y;
+                } else {
+                    int64_t acc = int64_t(c[0]) * x + s[0];
+                    int32_t y = static_cast<int32_t>((acc + (int64_t(1) << (COEFF_FRAC - 1))) >> COEFF_FRAC);
+                    s[0] = int64_t(c[1]) * x - int64_t(c[3]) * y + s[1];
+                    s[1] = int64_t(c[2]) * x - int64_t(c[4]) * y;
+                    x = y;
+                }
+            }
+            return x;
+        }
+
+        void reset() {
+            for (auto &s : state_) s[0] = s[1] = 0;
+        }
+
+        // Steady state for a constant input x0, valid when the first stage blocks DC
+        void reset(T x0) {
+            reset();
+            state_[0][0] = -(state_t(coeff_[0][0]) * x0);
+            state_[0][1] = state_t(coeff_[0][2]) * x0;
+        }
+
+        // Absorb a known step in the input level without a transient, same condition as reset(x0)
+        void shift(T delta) {
+            state_[0][0] -= state_t(coeff_[0][0]) * delta;
+            state_[0][1] += state_t(coeff_[0][2]) * delta;
+        }
+
+    private:
+        static constexpr coeff_t to_coeff(float v) {
+            if constexpr (std::is_same_v<T, float>) return v;
+            else return static_cast<int32_t>(v * (int32_t(1) << COEFF_FRAC) + (v < 0 ? -0.5f : 0.5f));
+        }
+
+        coeff_t coeff_[N][5] = {};
+        state_t state_[N][2] = {};
+
+    }; // class BiquadCascade
+
+} // namespace devices
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace devices {
+    enum class Presence {
+        ABSENT = 0,         // Sensor shut down between low-current probes
+        PRESENT             // Full acquisition profile
+    };
+
+    // Finger presence with hysteresis in both directions: PRESENT after CONFIRM_PROBES probe readings in a row
+    // above the probe threshold, ABSENT once the pipeline has rejected every sample for the absence timeout.
+    class FingerPresence {
+    public:
+        static constexpr uint8_t CONFIRM_PROBES = 2;
+
+        explicit FingerPresence(uint32_t probe_ir_min, int64_t absence_timeout_us)
+                                : probe_ir_min_(probe_ir_min), absence_timeout_us_(absence_timeout_us) {}
+
+        // One probe reading while ABSENT; true when it confirms presence
+        bool probe(uint32_t ir) {
+            probes_ = ir >= probe_ir_min_ ? probes_ + 1 : 0;
+            if (probes_ < CONFIRM_PROBES) return false;
+
+            state_ = Presence::PRESENT;
+            probes_ = 0;
+            last_finger_us_ = 0;
+            return true;
+        }
+
+        // Each acquired sample while PRESENT; true when the finger has been gone for the absence timeout
+        bool sample(bool finger, int64_t time_us) {
+            if (finger || !last_finger_us_) {
+                last_finger_us_ = time_us;
+                return false;
+            }
+            if (time_us - last_finger_us_ < absence_timeout_us_) return false;
+
+            state_ = Presence::ABSENT;
+            return true;
+        }
+
+        void set_absence_timeout(int64_t timeout_us) { absence_timeout_us_ = timeout_us; }
+        Presence state() const { return state_; }
+
+    private:
+        uint32_t probe_ir_min_;
+        int64_t absence_timeout_us_;
+        Presence state_ = Presence::ABSENT;
+        uint8_t probes_ = 0;
+        int64_t last_finger_us_ = 0;        // 0: no sample since presence was confirmed
+
+    }; // class FingerPresence
+
+} // namespace devices
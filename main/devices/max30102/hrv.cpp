@@ -0,0 +1,81 @@
+#include "hrv.h"
+#include <cmath>
+
+namespace devices {
+    void HrvStats::Moments::add(float rr_ms, float prev_ms) {
+        count++;
+        float delta = rr_ms - mean;
+        mean += delta / count;
+        m2 += delta * (rr_ms - mean);
+
+        if (prev_ms > 0) {
+            float diff = rr_ms - prev_ms;
+            diffs++;
+            diff_sq_sum += diff * diff;
+            if (std::fabs(diff) > NN50_MS) nn50++;
+        }
+    }
+
+    void HrvStats::Moments::merge(const Moments &other) {
+        if (other.count) {
+            uint16_t total = count + other.count;
+            float delta = other.mean - mean;
+            m2 += other.m2 + delta * delta * count * other.count / total;
+            mean += delta * other.count / total;
+            count = total;
+        }
+        diffs += other.diffs;
+        diff_sq_sum += other.diff_sq_sum;
+        nn50 += other.nn50;
+        rejected += other.rejected;
+    }
+
+    void HrvStats::add_interval(int64_t interval_us) {
+        if (!interval_us) {
+            prev_ms_ = 0;
+            return;
+        }
+
+        float rr_ms = interval_us / 1000.0f;
+        if (ref_ms_ > 0 && std::fabs(rr_ms - ref_ms_) > MAX_DEVIATION * ref_ms_ && ++rejects_ <= MAX_REJECTS) {
+            // A missed or extra beat: neither it nor the difference to it belongs in the statistics
+            window_.rejected++;
+            prev_ms_ = 0;
+            return;
+        }
+        if (rejects_ > MAX_REJECTS) ref_ms_ = rr_ms;
+        rejects_ = 0;
+
+        window_.add(rr_ms, prev_ms_);
+        prev_ms_ = rr_ms;
+        ref_ms_ = ref_ms_ > 0 ? 0.75f * ref_ms_ + 0.25f * rr_ms : rr_ms;
+    }
+
+    void HrvStats::end_window(bool keep) {
+        if (keep) period_.merge(window_);
+        else prev_ms_ = 0;
+        window_ = {};
+    }
+
+    HrvReport HrvStats::finish(int64_t now_us) {
+        HrvReport report = {now_us, period_.mean, -1, -1, -1, period_.count, period_.rejected};
+
+        if (period_.count >= 2) report.sdnn = std::sqrt(period_.m2 / (period_.count - 1));
+        if (period_.diffs) {
+            report.rmssd = std::sqrt(period_.diff_sq_sum / period_.diffs);
+            report.pnn50 = 100.0f * period_.nn50 / period_.diffs;
+        }
+
+        period_ = {};
+        return report;
+    }
+
+    void HrvStats::reset() {
+        window_ = {};
+        period_ = {};
+        prev_ms_ = 0;
+        ref_ms_ = 0;
+        rejects_ = 0;
+    }
+
+} // namespace devices
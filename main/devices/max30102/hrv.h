@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+namespace devices {
+    struct HrvReport {
+        int64_t end_us;             // End of the period, 0 before the first report
+        float mean_rr;              // ms
+        float sdnn;                 // ms, -1 with fewer than 2 intervals
+        float rmssd;                // ms, -1 without successive differences
+        float pnn50;                // % of successive differences above 50 ms, -1 without any
+        uint16_t intervals;         // Accepted RR intervals
+        uint16_t rejected;          // Artifacts and ectopic beats left out
+    };
+
+    // RR interval statistics in constant memory. Intervals collect per window with Welford updates;
+    // windows that pass the quality gate are merged into the period (Chan et al.), the others are dropped,
+    // and finish() reports the period. Successive differences only pair intervals with no break between them.
+    class HrvStats {
+    public:
+        static constexpr float MAX_DEVIATION = 0.2f;            // Of the reference interval, larger jumps are artifacts
+        static constexpr uint8_t MAX_REJECTS = 3;               // In a row, then the reference follows the new rhythm
+        static constexpr float NN50_MS = 50.0f;
+        static constexpr uint16_t MIN_INTERVALS = 20;           // Fewer make no usable report
+
+        void add_interval(int64_t interval_us);                 // 0 breaks the chain (first beat, gap)
+        void end_window(bool keep);
+        HrvReport finish(int64_t now_us);                       // Report for the period so far, then start a new one
+        void reset();
+
+    private:
+        struct Moments {
+            uint16_t count = 0;
+            float mean = 0;
+            float m2 = 0;
+            uint16_t diffs = 0;
+            float diff_sq_sum = 0;
+            uint16_t nn50 = 0;
+            uint16_t rejected = 0;
+
+            void add(float rr_ms, float prev_ms);
+            void merge(const Moments &other);
+        };
+
+        Moments window_;
+        Moments period_;
+        float prev_ms_ = 0;         // Last accepted interval, 0 after a break
+        float ref_ms_ = 0;          // Smoothed accepted interval for the artifact check
+        uint8_t rejects_ = 0;
+
+    }; // class HrvStats
+
+} // namespace devices
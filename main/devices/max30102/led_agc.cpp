@@ -0,0 +1,36 @@
+#include "led_agc.h"
+#include <algorithm>
+
+namespace devices {
+    bool LedAgc::update(uint32_t red, uint32_t ir) {
+        if (red < DC_PRESENCE || ir < DC_PRESENCE) {
+            red_sum_ = 0;
+            ir_sum_ = 0;
+            count_ = 0;
+            return false;
+        }
+
+        red_sum_ += red;
+        ir_sum_ += ir;
+        if (++count_ < PERIOD) return false;
+
+        uint8_t red_pa = adjust(red_pa_, red_sum_ / count_);
+        uint8_t ir_pa = adjust(ir_pa_, ir_sum_ / count_);
+        red_sum_ = 0;
+        ir_sum_ = 0;
+        count_ = 0;
+
+        if (red_pa == red_pa_ && ir_pa == ir_pa_) return false;
+        red_pa_ = red_pa;
+        ir_pa_ = ir_pa;
+        return true;
+    }
+
+    uint8_t LedAgc::adjust(uint8_t pa, uint32_t dc) {
+        if (dc >= DC_LOW && dc <= DC_HIGH) return pa;
+
+        uint32_t target = static_cast<uint32_t>(uint64_t(pa) * DC_TARGET / dc);
+        return static_cast<uint8_t>(std::clamp<uint32_t>(target, PA_MIN, PA_MAX));
+    }
+
+} // namespace devices
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+namespace devices {
+    // LED pulse amplitude control: keeps the DC level of each channel inside [DC_LOW, DC_HIGH].
+    // DC scales roughly linearly with LED current, so one proportional step lands near DC_TARGET;
+    // inside the band nothing changes (hysteresis). Below DC_PRESENCE there is no finger to track.
+    class LedAgc {
+    public:
+        static constexpr uint32_t DC_PRESENCE = 20000;
+        static constexpr uint32_t DC_LOW = 100000;
+        static constexpr uint32_t DC_TARGET = 150000;
+        static constexpr uint32_t DC_HIGH = 200000;         // 18-bit ADC saturates at 262143
+        static constexpr uint8_t PA_MIN = 0x08;
+        static constexpr uint8_t PA_MAX = 0xFF;
+        static constexpr uint16_t PERIOD = 25;              // Samples averaged per decision (2 s at 12.5 sps)
+
+        LedAgc(uint8_t red_pa, uint8_t ir_pa) : red_pa_(red_pa), ir_pa_(ir_pa) {}
+
+        bool update(uint32_t red, uint32_t ir);
+
+        uint8_t red_pa() const { return red_pa_; }
+        uint8_t ir_pa() const { return ir_pa_; }
+
+    private:
+        static uint8_t adjust(uint8_t pa, uint32_t dc);
+
+        uint8_t red_pa_;
+        uint8_t ir_pa_;
+        uint64_t red_sum_ = 0;
+        uint64_t ir_sum_ = 0;
+        uint16_t count_ = 0;
+
+    }; // class LedAgc
+
+} // namespace devices
@@ -1,40 +1,39 @@
 #include "max30102.h"
 #include "esp_log.h"
+#include "esp_cpu.h"
 #include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "core/event_manager.h"
 
 static const char *TAG = "MAX30102";
 
+using namespace core;
 using namespace peripherals;
 
 namespace devices {
-    float MAX30102::spo2_ = 0;
-    int MAX30102::heart_rate_ = 0;
-
-    GPIO gpio;
-    int64_t last_time_beat = 0;
-    int64_t last_last_time_beat = 0;
-    int64_t last_last_last_time_beat = 0;
-    int64_t final_last_time_beat = 0;
-    uint64_t last_beat = 0;
-    uint64_t last_last_beat = 0;
-    uint8_t i = 0;
-    bool MAX30102::new_val = false;
-    bool MAX30102::new_val1 = false;
+    auto &ev_max30102 = EventManager::instance();
 
     static void intr_handle(void *arg) {
         MAX30102 *self = static_cast<MAX30102*>(arg);
+        self->intr_stamp_.record(esp_timer_get_time());
         BaseType_t hpw = pdFALSE;
         vTaskNotifyGiveFromISR(self->sensor_task_, &hpw);
         portYIELD_FROM_ISR(hpw);
     }
 
     MAX30102::MAX30102(peripherals::I2C *i2c_driver, i2c_port_num_t i2c_port_num, uint16_t device_address, uint32_t i2c_freq_hz,
-                        EnableLog show_values_log)
+                        gpio_num_t intr_pin, EnableLog show_values_log, FifoMode fifo_mode, AcquisitionProfile profile)
                             : i2c_driver_(i2c_driver),
                             i2c_port_num_(i2c_port_num),
                             device_address_(device_address),
                             i2c_freq_hz_(i2c_freq_hz),
-                            show_values_log_(show_values_log) {}
+                            intr_pin_(intr_pin),
+                            show_values_log_(show_values_log),
+                            fifo_mode_(fifo_mode),
+                            ppg_(profile),
+                            requested_profile_(profile) {}
 
     MAX30102::~MAX30102() {
         if (sensor_task_) {
@@ -42,6 +41,8 @@ namespace devices {
             sensor_task_ = nullptr;
         }
 
+        gpio_isr_handler_remove(intr_pin_);
+
         i2c_driver_->remove_dev(dev_handle_);
         ESP_LOGI(TAG, "MAX30102 deleted.");
     }
@@ -50,13 +51,7 @@ namespace devices {
         i2c_driver_->add_dev(i2c_port_num_, &dev_handle_, device_address_, i2c_freq_hz_);
         ESP_LOGI(TAG, "MAX30102 Added");
 
-        esp_timer_create_args_t log_timer_arg = {
-            .callback = enable_timer_callback,
-            .arg = this,
-            .name = "MAX30102 timer",
-        };
-        esp_timer_create(&log_timer_arg, &start_timer_);
-        esp_timer_start_periodic(start_timer_, 1000 * FILTER_TIME);
+        clock_.restart(ppg_.get_profile_config().sample_period_us);
 
         while (true) {
             if (querry(PART_ID) == 0x15) {
@@ -69,33 +64,147 @@ namespace devices {
             }
         }
 
-        gpio.input_config(MAX30102_INTR, GPIO_MODE_INPUT, GPIO_PULLUP_ENABLE, GPIO_PULLDOWN_DISABLE, GPIO_INTR_NEGEDGE);
-        gpio_install_isr_service(0);
-        gpio_isr_handler_add(MAX30102_INTR, intr_handle, this);
+        GPIO::input_config(intr_pin_, GPIO_MODE_INPUT, GPIO_PULLUP_ENABLE, GPIO_PULLDOWN_DISABLE, GPIO_INTR_NEGEDGE);
+        gpio_install_isr_service(0);        // ESP_ERR_INVALID_STATE when another instance already installed it
+        gpio_isr_handler_add(intr_pin_, intr_handle, this);
     }
 
-    void MAX30102::start() {
+    void MAX30102::start(BaseType_t core_id) {
         init();
 
         xTaskCreatePinnedToCore([](void *arg) { static_cast<MAX30102 *>(arg)->start_task(arg); },
-            "Start MAX30102 task", 1024 * 4, this, 2, &sensor_task_, 1
+            "Start MAX30102 task", 1024 * 4, this, 2, &sensor_task_, core_id
         );
     }
 
     void MAX30102::start_task(void *pvParameters) {
+        suspend_acquisition();
+
         while (true) {
+            if (presence_.state() == Presence::ABSENT) {
+                // set_profile() notifications also end the wait
+                ulTaskNotifyTake(pdTRUE, PROBE_INTERVAL_MS / portTICK_PERIOD_MS);
+                apply_profile();
+                apply_engine();
+                if (probe_presence()) {
+                    resume_acquisition();
+                    ev_max30102.publish_intr(EventID::FINGER_PRESENCE, static_cast<int>(Presence::PRESENT));
+                    ESP_LOGI(TAG, "Finger detected, %s acquisition", profile_name(ppg_.get_profile()));
+                }
+                continue;
+            }
+
             if (ulTaskNotifyTake(pdTRUE, 500 / portTICK_PERIOD_MS) == pdTRUE) {
-                uint8_t ret;
-                ret = querry(INTR_1);
-                if (ret & 0x40) querry();
-                // else if (ret & 0x01) config();
+                if (fifo_mode_ == FifoMode::ALMOST_FULL) {
+                    drain_fifo();
+                } else {
+                    uint8_t ret;
+                    ret = querry(INTR_1);
+                    if (ret & INTR_PPG_RDY) querry();
+                    // else if (ret & 0x01) config();
+                }
+            } else if (fifo_mode_ == FifoMode::ALMOST_FULL && !gpio_get_level(intr_pin_)) {
+                drain_fifo();       // Edge missed while the line was already held low
+            }
+            apply_profile();
+
+            if (absence_pending_) {
+                absence_pending_ = false;
+                suspend_acquisition();
+                ev_max30102.publish_intr(EventID::FINGER_PRESENCE, static_cast<int>(Presence::ABSENT));
+                ESP_LOGI(TAG, "No finger, sensor shut down until the next probe");
             }
         }
     }
 
-    void MAX30102::enable_timer_callback(void *pvParameters) {
-        MAX30102 *arg = static_cast<MAX30102 *>(pvParameters);
-        arg->timer_on_1_ = true;
+    // Timestamp of the interrupt behind the batch being read, 0 when no new one arrived (edge missed, timeout)
+    int64_t MAX30102::take_intr_time() {
+        uint32_t count;
+        int64_t time_us = intr_stamp_.read(count);
+
+        if (count == intr_taken_) return 0;
+        intr_taken_ = count;
+        return time_us;
+    }
+
+    void MAX30102::set_profile(AcquisitionProfile profile) {
+        requested_profile_.store(profile, std::memory_order_relaxed);
+        if (sensor_task_) xTaskNotifyGive(sensor_task_);
+    }
+
+    // Sensor task, with no window open or right after one closed, so an engine never sees a partial window
+    void MAX30102::apply_engine() {
+        HrEngine engine = requested_engine_.load(std::memory_order_relaxed);
+        if (engine == ppg_.get_engine()) return;
+
+        ppg_.set_engine(engine);
+        ESP_LOGI(TAG, "Heart-rate engine %d", static_cast<int>(engine));
+    }
+
+    // Between FIFO batches on the sensor task, so no sample of the old rate reaches the new pipeline
+    void MAX30102::apply_profile() {
+        AcquisitionProfile profile = requested_profile_.load(std::memory_order_relaxed);
+        if (profile == ppg_.get_profile()) return;
+
+        const ProfileConfig cfg = profile_config(profile);
+        ppg_.set_profile(profile, esp_timer_get_time());
+        if (presence_.state() == Presence::PRESENT) {
+            config(MODE_CONFIG, MAX30102_SLEEP_ON | MAX30102_MULTI_LED);     // Registers are kept in shutdown
+            resume_acquisition();
+        }
+
+        ESP_LOGI(TAG, "Profile %s: %.1f sps, %d ms window", profile_name(profile), cfg.sample_rate_hz, cfg.window_ms);
+    }
+
+    // Profile registers and LED currents back in place, FIFO emptied, then out of shutdown
+    void MAX30102::resume_acquisition() {
+        const ProfileConfig &cfg = ppg_.get_profile_config();
+        config(INTR_EN_1, fifo_mode_ == FifoMode::ALMOST_FULL ? INTR_A_FULL : INTR_PPG_RDY);
+        config(FIFO_CONFIG, cfg.fifo_config);
+        config(SPO2_SCALE_CONFIG, cfg.spo2_config);
+        config(LED2_PA, led_agc_.red_pa());
+        config(LED1_PA, led_agc_.ir_pa());
+        config(FIFO_WRITE_PTR, 0x00);
+        config(OVER_FLOW_COUNTER, 0x00);
+        config(FIFO_READ_PTR, 0x00);
+        querry(INTR_1);
+
+        clock_.restart(cfg.sample_period_us);
+        take_intr_time();       // A stamp from before the restart must not anchor the new timebase
+        window_end_us_ = 0;
+        config(MODE_CONFIG, MAX30102_SLEEP_OFF | MAX30102_MULTI_LED);
+    }
+
+    // Shutdown (LEDs off, ~1 uA) with the probe settings loaded, so a probe only toggles the mode register
+    void MAX30102::suspend_acquisition() {
+        config(MODE_CONFIG, MAX30102_SLEEP_ON | MAX30102_MULTI_LED);
+        config(INTR_EN_1, INTR_PPG_RDY);
+        config(FIFO_CONFIG, PROBE_FIFO_CONFIG);
+        config(SPO2_SCALE_CONFIG, PROBE_SPO2_CONFIG);
+        config(LED2_PA, 0x00);
+        config(LED1_PA, PROBE_IR_PA);
+        ppg_.reset(esp_timer_get_time());
+    }
+
+    bool MAX30102::probe_presence() {
+        config(FIFO_WRITE_PTR, 0x00);
+        config(OVER_FLOW_COUNTER, 0x00);
+        config(FIFO_READ_PTR, 0x00);
+        querry(INTR_1);
+        ulTaskNotifyTake(pdTRUE, 0);
+        config(MODE_CONFIG, MAX30102_SLEEP_OFF | MAX30102_MULTI_LED);
+
+        bool ready = ulTaskNotifyTake(pdTRUE, PROBE_WAIT_MS / portTICK_PERIOD_MS) == pdTRUE || (querry(INTR_1) & INTR_PPG_RDY);
+        uint8_t data[SAMPLE_BYTES] = {};
+        if (ready) {
+            trans_buf_[0] = FIFO_DATA;
+            ready = i2c_driver_->write_read(dev_handle_, trans_buf_, 1, data, SAMPLE_BYTES) == ESP_OK;
+        }
+        config(MODE_CONFIG, MAX30102_SLEEP_ON | MAX30102_MULTI_LED);
+        take_intr_time();
+
+        uint32_t ir = ((data[0] & 0x03) << 16) | (data[1] << 8) | data[2];
+        return ready && presence_.probe(ir);
     }
 
     void MAX30102::config(uint8_t reg, uint8_t option) {
@@ -108,13 +217,13 @@ namespace devices {
         config(MODE_CONFIG, MAX30102_RESET);
         querry(INTR_1);
 
-        config(INTR_EN_1, 0x40);
-        config(FIFO_CONFIG, 0x7F);
+        config(INTR_EN_1, fifo_mode_ == FifoMode::ALMOST_FULL ? INTR_A_FULL : INTR_PPG_RDY);
+        config(FIFO_CONFIG, ppg_.get_profile_config().fifo_config);
         config(MODE_CONFIG, MAX30102_MULTI_LED);
-        config(SPO2_SCALE_CONFIG, 0x47);
+        config(SPO2_SCALE_CONFIG, ppg_.get_profile_config().spo2_config);
 
-        config(LED2_PA, 0x5F);         // LED 2 Pulse Amplitude register (Red led)
-        config(LED1_PA, 0x6F);         // LED 1 Pulse Amplitude register (IR led)
+        config(LED2_PA, led_agc_.red_pa());     // LED 2 Pulse Amplitude register (Red led)
+        config(LED1_PA, led_agc_.ir_pa());      // LED 1 Pulse Amplitude register (IR led)
 
         config(SLOT_12, 0x21);         /* Slot 1 RED led (SpO2 measurement) */   /* Slot 2 IR led (Heart rate measurement) */
         config(SLOT_34, 0x00);
@@ -126,7 +235,7 @@ namespace devices {
     }
 
     uint8_t MAX30102::querry(uint8_t reg) {
-        uint8_t data;
+        uint8_t data = 0;           // Reads as no flags set when the transaction fails
         trans_buf_[0] = reg;
         i2c_driver_->write_read(dev_handle_, trans_buf_, 1, &data, 1);
 
@@ -134,140 +243,166 @@ namespace devices {
     }
 
     void MAX30102::querry() {
-        uint8_t data[6];
+        uint8_t data[SAMPLE_BYTES];
         trans_buf_[0] = FIFO_DATA;
-        uint32_t ir_;
-        uint32_t red_;
 
         // trans_buf_[1] = 0x05;
         // i2c_driver_->write_read(dev_handle_, &trans_buf_[1], 1, data, 2);
         // ESP_LOGW(TAG, "%d %d", data[0], data[1]);
 
-        i2c_driver_->write_read(dev_handle_, trans_buf_, 1, data, 6);
-        ir_ = ((data[0] & 0x03) << 16) | ((data[1] << 8) | data[2]);
-        red_ = ((data[3] & 0x03) << 16) | ((data[4] << 8) | data[5]);
-
-        // ESP_LOGW(TAG, "%ld", red_);
-        // ESP_LOGW(TAG, "%ld", ir_);
-
-        if (red_ >= 80000 && ir_ >= 60000) {
-            ir_cache_.push_back(ir_);
-            red_cache_.push_back(red_);
-        } else {
-            ir_cache_.clear();
-            red_cache_.clear();
-
-            last_time_beat = esp_timer_get_time();
-            last_last_time_beat = 0;
-            final_last_time_beat = 0;
-            esp_timer_stop(start_timer_);
-            esp_timer_start_periodic(start_timer_, 1000 * FILTER_TIME);
-            timer_on_1_ = false;
-        }
+        if (i2c_driver_->write_read(dev_handle_, trans_buf_, 1, data, SAMPLE_BYTES) != ESP_OK) return;
+        int64_t intr_us = take_intr_time();
+        clock_.batch(intr_us ? intr_us : (clock_.synced() ? 0 : esp_timer_get_time()), 1, 0, false);
+        process_sample(data, clock_.time(0));
+        apply_led_agc();
+    }
 
-        if (timer_on_1_) {
-            timer_on_1_ = false;
+    void MAX30102::drain_fifo() {
+        // INTR_1 .. FIFO_READ_PTR in one read: clears A_FULL and fetches both FIFO pointers
+        uint8_t regs[FIFO_READ_PTR - INTR_1 + 1];
+        trans_buf_[0] = INTR_1;
+        if (i2c_driver_->write_read(dev_handle_, trans_buf_, 1, regs, sizeof(regs)) != ESP_OK) return;
 
-            caculate();
+        uint8_t count = (regs[FIFO_WRITE_PTR] - regs[FIFO_READ_PTR]) & (FIFO_DEPTH - 1);
+        if (regs[OVER_FLOW_COUNTER]) count = FIFO_DEPTH;
+        if (!count) return;
 
-            ir_cache_.clear();
-            red_cache_.clear();
-            new_val = true;
-            new_val1 = true;
-        }
+        // FIFO_DATA does not auto-increment, so one read pops every pending sample
+        trans_buf_[0] = FIFO_DATA;
+        if (i2c_driver_->write_read(dev_handle_, trans_buf_, 1, fifo_buf_, count * SAMPLE_BYTES) != ESP_OK) return;
+
+        // The interrupt fired as the almost-full sample was written; without a stamp the newest sample
+        // was taken just before the read
+        int64_t intr_us = take_intr_time();
+        uint8_t a_full = FIFO_DEPTH - (ppg_.get_profile_config().fifo_config & FIFO_A_FULL_MASK);
+        if (intr_us) clock_.batch(intr_us, count, std::min(count, a_full) - 1, regs[OVER_FLOW_COUNTER]);
+        else if (clock_.synced()) clock_.batch(0, count, 0, false);
+        else clock_.batch(esp_timer_get_time(), count, count - 1, false);
+
+        for (uint8_t i = 0; i < count; i++) process_sample(&fifo_buf_[i * SAMPLE_BYTES], clock_.time(i));
+        apply_led_agc();
     }
 
-    void MAX30102::caculate() {
-        int filter = 2;
-        uint64_t beat = 0;
-        std::vector<float> spo2_cache;
-        float low_red = 0;
-        float low_ir = 0;
-        float sum_red = 0;
-        float sum_ir = 0;
+    void MAX30102::apply_led_agc() {
+        if (!agc_pending_) return;
+        agc_pending_ = false;
 
-        for (float v : red_cache_) sum_red += v;
-        for (float v : ir_cache_)  sum_ir  += v;
+        config(LED2_PA, led_agc_.red_pa());
+        config(LED1_PA, led_agc_.ir_pa());
+        led_changed_ = true;
 
-        float red_dc = sum_red / red_cache_.size();
-        float ir_dc = sum_ir / ir_cache_.size();
-
-        for (int i = filter; i < red_cache_.size() - filter; i++) {
-            uint8_t var1 = 0;
-            uint8_t var2 = 0;
+        if (show_values_log_ == EnableLog::SHOW_ON) {
+            ESP_LOGI(TAG, "LED amplitude red 0x%02X, ir 0x%02X", led_agc_.red_pa(), led_agc_.ir_pa());
+        }
+    }
 
-            for (int j = -filter; j < filter + 1; j++) {
-                if (red_cache_[i] < red_cache_[i+j]) var1++;
-                else if (red_cache_[i] > red_cache_[i+j]) var2++;
-            }
+    void MAX30102::process_sample(const uint8_t *data, int64_t time_us) {
+        uint32_t ir_;
+        uint32_t red_;
 
-            if (var1 == filter * 2) {
-                low_red = red_cache_[i];
-                low_ir = ir_cache_[i];
-            }
+        ir_ = ((data[0] & 0x03) << 16) | ((data[1] << 8) | data[2]);
+        red_ = ((data[3] & 0x03) << 16) | ((data[4] << 8) | data[5]);
 
-            if (var2 == filter * 2) {
-                beat++;
-                if (low_red && low_ir) {
-                    float red_ac = ((float)red_cache_[i] - low_red);
-                    float ir_ac = ((float)ir_cache_[i] - low_ir);
+        // ESP_LOGW(TAG, "%ld", red_);
+        // ESP_LOGW(TAG, "%ld", ir_);
 
-                    float red_ratio = std::min(0.0025f, std::max(red_ac / red_dc, 0.001f));
-                    float ir_ratio  = std::min(0.0025f, std::max(ir_ac / ir_dc, 0.001f));
-                    // float red_ratio = std::max(red_ac / red_dc, 0.001f);
-                    // float ir_ratio  = std::max(ir_ac / ir_dc, 0.0025f);
-                    // float red_ratio = red_ac / red_dc;
-                    // float ir_ratio  = ir_ac / ir_dc;
-                    float r  = red_ratio / ir_ratio;
+        int64_t window_us = 1000LL * ppg_.get_profile_config().window_ms;
+        if (!window_end_us_) {
+            ppg_.reset(time_us);        // Rates count from the first sample on the new timebase
+            window_end_us_ = time_us + window_us;
+        }
 
-                    // ESP_LOGE(TAG, "%f", red_ratio);
-                    // ESP_LOGE(TAG, "%f", ir_ratio);
-                    ESP_LOGE(TAG, "%f", r);
+        if (waveform_) waveform_->push(red_, ir_, time_us, ppg_.get_profile_config().sample_period_us);
 
-                    float spo2_val = 110 - 25 * r;
+        // Accelerometer mean over the same interval as this (averaged) PPG sample
+        MotionRef motion;
+        bool has_motion = motion_ && motion_->mean(time_us - ppg_.get_profile_config().sample_period_us, time_us, motion.accel);
 
-                    // if (spo2_val > 100.0f) spo2_val = 100.0f;
-                    // if (spo2_val < 90.0f)  spo2_val = 90.0f;
+        PpgEvent event = ppg_.push(red_, ir_, time_us, led_changed_, has_motion ? &motion : nullptr);
+        led_changed_ = false;
+        if (led_agc_.update(red_, ir_)) agc_pending_ = true;
 
-                    spo2_cache.push_back(spo2_val);
-                }
-                low_red = 0;
-                low_ir = 0;
+        if (presence_.sample(event != PpgEvent::NO_FINGER, time_us)) absence_pending_ = true;
+        if (event == PpgEvent::NO_FINGER) {
+            window_end_us_ = time_us + window_us;
+        } else if (event == PpgEvent::BEAT) {
+            beats_.publish(ppg_.get_beat_detector().last_beat());
+            if (ppg_.get_engine() == HrEngine::STREAMING && ppg_.get_heart_rate()) {
+                vitals_.publish({time_us, ppg_.get_heart_rate(), ppg_.get_spo2(), ppg_.get_quality(), ppg_.get_hrv()});
             }
         }
 
-        // float max = spo2_cache[0];
-        // for (float v : spo2_cache) if (v > max) max = v;
-        // // for (int i = 1; i < spo2_cache.size(); i++) {
-        // //     if (spo2_cache[i] > max) max = spo2_cache[i];
-        // // }
-        // spo2_ = max;
-
-        // std::sort(spo2_cache.begin(), spo2_cache.end());
-        // float sum = 0;
-        // for (int i = spo2_cache.size() / 2; i < spo2_cache.size(); i++) sum += spo2_cache[i];
-        // // for (float v : spo2_cache) if (v >= 85) sum += v;
-        // spo2_ = sum / (spo2_cache.size() * 2);
-
-        float spo2_median = spo2_cache[spo2_cache.size() / 2];
-        static float spo2_filtered = 97.0f;
-        spo2_filtered = std::min(100.0f, spo2_filtered * 0.8f + spo2_median * 0.23f);
-        spo2_ = spo2_filtered;
+        if (time_us >= window_end_us_) {
+            window_end_us_ += window_us;
+            if (window_end_us_ <= time_us) window_end_us_ = time_us + window_us;     // After a stall
+            caculate(time_us);
+            apply_engine();
+        }
+    }
 
-        if (!last_last_time_beat) heart_rate_ = beat * 60 * 1000000 / (esp_timer_get_time() - last_time_beat);
-        else if (!final_last_time_beat) heart_rate_ = (beat + last_beat) * 60 * 1000000 / (esp_timer_get_time() - last_last_time_beat);
-        else heart_rate_ = (beat + last_beat + last_last_beat) * 60 * 1000000 / (esp_timer_get_time() - final_last_time_beat);
+    void MAX30102::filter_benchmark() {
+        constexpr int SAMPLES = 1000;
+        using Pipeline = PpgPipeline<AcquisitionProfile::STANDARD>;
+        constexpr auto &PPG_BANDPASS = Pipeline::PPG_BANDPASS;
+        constexpr int FILTER_FRAC = Pipeline::FILTER_FRAC;
+        BiquadCascade<float, PPG_BANDPASS.size()> float_filter(PPG_BANDPASS);
+        BiquadCascade<int32_t, PPG_BANDPASS.size()> fixed_filter(PPG_BANDPASS);
+        volatile float float_out;
+        volatile int32_t fixed_out;
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (int i = 0; i < SAMPLES; i++) float_out = float_filter.process(static_cast<float>((100000 + (i & 0xFF)) << FILTER_FRAC));
+        uint32_t float_cycles = esp_cpu_get_cycle_count() - start;
+
+        start = esp_cpu_get_cycle_count();
+        for (int i = 0; i < SAMPLES; i++) fixed_out = fixed_filter.process(static_cast<int32_t>((100000 + (i & 0xFF)) << FILTER_FRAC));
+        uint32_t fixed_cycles = esp_cpu_get_cycle_count() - start;
+
+        MotionCanceller<Pipeline::Traits::MOTION_TAPS> canceller(PPG_BANDPASS);
+        start = esp_cpu_get_cycle_count();
+        for (int i = 0; i < SAMPLES; i++) {
+            float accel[3] = {static_cast<float>(i & 0x3FF), 0, 2048};
+            int32_t red = (i & 0xFF) << FILTER_FRAC, ir = (i & 0x7F) << FILTER_FRAC;
+            canceller.process(red, ir, accel);
+            fixed_out = red + ir;
+        }
+        uint32_t motion_cycles = esp_cpu_get_cycle_count() - start;
+
+        // One window through the spectral engine, the FFT buffer is static to keep it off the task stack
+        using Spectral = SpectralHr<Pipeline::Traits::SPECTRAL_SIZE, Pipeline::Traits::SPECTRAL_DECIMATION>;
+        static Spectral spectral;
+        static float window[Pipeline::Traits::WINDOW_MS * 1000LL / Pipeline::SAMPLE_PERIOD_US];
+        for (size_t i = 0; i < std::size(window); i++) window[i] = 1000.0f * std::sin(2.0f * 3.14159265f * 1.2f * i / Pipeline::SAMPLE_RATE_HZ);
+        spectral.estimate(std::span<const float>(window), Pipeline::SAMPLE_RATE_HZ);       // Builds the twiddle table
+        start = esp_cpu_get_cycle_count();
+        fixed_out = spectral.estimate(std::span<const float>(window), Pipeline::SAMPLE_RATE_HZ);
+        uint32_t spectral_cycles = esp_cpu_get_cycle_count() - start;
+
+        (void)float_out;
+        (void)fixed_out;
+        ESP_LOGI(TAG, "Band-pass cycles/sample: float %" PRIu32 ", fixed %" PRIu32, float_cycles / SAMPLES, fixed_cycles / SAMPLES);
+        ESP_LOGI(TAG, "Motion canceller cycles/sample: %" PRIu32, motion_cycles / SAMPLES);
+        ESP_LOGI(TAG, "Spectral engine cycles/window: %" PRIu32 " (%zu samples, %zu-point FFT)", spectral_cycles, std::size(window),
+                Pipeline::Traits::SPECTRAL_SIZE);
+    }
 
-        last_last_beat = last_beat;
-        last_beat = beat;
+    void MAX30102::caculate(int64_t now_us) {
+        if (!ppg_.caculate(now_us)) return;
 
-        final_last_time_beat = last_last_time_beat;
-        last_last_time_beat = last_time_beat;
-        last_time_beat = esp_timer_get_time();
+        const SignalQualityReport &quality = ppg_.get_quality();
+        const HrvReport &hrv = ppg_.get_hrv();
+        vitals_.publish({now_us, ppg_.get_heart_rate(), ppg_.get_spo2(), quality, hrv});
 
         if (show_values_log_ == EnableLog::SHOW_ON) {
-            ESP_LOGW(TAG, "%d", get_heart_rate());
-            ESP_LOGW(TAG, "%f", get_spo2());
+            ESP_LOGW(TAG, "%d (windowed %d, streaming %d)", ppg_.get_heart_rate(), ppg_.get_windowed_bpm(),
+                    ppg_.get_beat_detector().get_heart_rate());
+            ESP_LOGW(TAG, "%f", ppg_.get_spo2());
+            ESP_LOGW(TAG, "Quality %u: PI %.2f%%, interval CV %.2f, clipped %u/%u", quality.score, quality.perfusion_index,
+                    quality.interval_cv, quality.clipped, quality.samples);
+            if (hrv.end_us == now_us) {
+                ESP_LOGW(TAG, "HRV: RMSSD %.1f ms, SDNN %.1f ms, pNN50 %.1f%% (%u RR, %u rejected)", hrv.rmssd, hrv.sdnn, hrv.pnn50,
+                        hrv.intervals, hrv.rejected);
+            }
         }
     }
 
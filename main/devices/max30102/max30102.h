@@ -1,6 +1,6 @@
 #pragma once
 
-#include <vector>
+#include <atomic>
 // #include <iostream>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,55 +9,89 @@
 #include "peripherals/gpio.h"
 #include "peripherals/i2c.h"
 #include "common/config.h"
+#include "core/result_channel.h"
+#include "ppg_processor.h"
+#include "led_agc.h"
+#include "common/sample_clock.h"
+#include "common/intr_stamp.h"
+#include "finger_presence.h"
+#include "devices/mpu6050/motion_history.h"
+#include "protocols/mqtt/waveform_stream.h"
 
 namespace devices {
+    enum class FifoMode {
+        PPG_READY = 0,      // One interrupt and one 6-byte read per sample
+        ALMOST_FULL         // Burst-drain the whole FIFO on the almost-full interrupt
+    };
+
+    struct Vitals {
+        int64_t time_us;                // Sample time the result was computed at
+        int heart_rate;                 // bpm
+        float spo2;                     // %
+        SignalQualityReport quality;    // Of the window behind this reading
+        HrvReport hrv;                  // Of the last finished HRV period
+    };
+
     class MAX30102 {
     public:
         TaskHandle_t sensor_task_ = nullptr;
-        static float spo2_;        // %
-        static int heart_rate_;    // bpm
+        common::IntrStamp intr_stamp_;              // esp_timer time of the last interrupt, written by the ISR
 
         MAX30102(peripherals::I2C *i2c_driver, i2c_port_num_t i2c_port_num, uint16_t device_address, uint32_t i2c_freq_hz,
-                EnableLog show_values_log);
+                gpio_num_t intr_pin, EnableLog show_values_log, FifoMode fifo_mode = FifoMode::ALMOST_FULL,
+                AcquisitionProfile profile = AcquisitionProfile::STANDARD);
         ~MAX30102();
 
         void init();
-        void start();
+        void start(BaseType_t core_id = 1);
 
         void start_task(void *pvParameters);
         void config(uint8_t reg, uint8_t option);
         void config();
         uint8_t querry(uint8_t reg);
         void querry();
-        void caculate();
-        float get_spo2() { return spo2_; }
-        int get_heart_rate() { return heart_rate_; }
-
-        static bool is_new_val() {
-            if (new_val) {
-                new_val = false;
-                return true;
-            }
-            return false;
-        }
-
-        static bool is_new_val_1() {
-            if (new_val1) {
-                new_val1 = false;
-                return true;
-            }
-            return false;
-        }
+        void drain_fifo();
+        void process_sample(const uint8_t *data, int64_t time_us);
+        void apply_led_agc();
+        void apply_profile();
+        void apply_engine();
+        void resume_acquisition();
+        void suspend_acquisition();
+        bool probe_presence();
+        int64_t take_intr_time();
+        void caculate(int64_t now_us);
+        static void filter_benchmark();
+        core::ResultChannel<Vitals> &vitals() { return vitals_; }
+        core::ResultChannel<BeatEvent> &beats() { return beats_; }
+        void set_engine(HrEngine engine) { requested_engine_.store(engine, std::memory_order_relaxed); }
+        HrEngine get_engine() { return requested_engine_.load(std::memory_order_relaxed); }
+        void set_profile(AcquisitionProfile profile);
+        AcquisitionProfile get_profile() { return requested_profile_.load(std::memory_order_relaxed); }
+        void set_motion_source(const MotionHistory *motion) { motion_ = motion; }     // Before start()
+        void set_waveform_stream(protocols::WaveformStream *waveform) { waveform_ = waveform; }  // Before start()
+        void set_absence_timeout(uint32_t timeout_ms) { presence_.set_absence_timeout(1000LL * timeout_ms); }   // Before start()
+        Presence get_presence() { return presence_.state(); }
 
     private:
-        static constexpr int MAX_CACHE_SIZE = 200;
-        static constexpr int FILTER_TIME = 10000;
+        static constexpr uint8_t RED_PA_DEFAULT = 0x5F;
+        static constexpr uint8_t IR_PA_DEFAULT = 0x6F;
 
         static constexpr uint8_t PART_ID = 0xFF;
 
     // Interrupt status
         static constexpr uint8_t INTR_1 = 0x00;                 // Interrupt status 1 register
         static constexpr uint8_t INTR_2 = 0x01;                 // Interrupt status 2 register
+        static constexpr uint8_t INTR_A_FULL = 0x80;            // FIFO almost full flag
+        static constexpr uint8_t INTR_PPG_RDY = 0x40;           // New FIFO data ready flag
+
+    // Presence probe: one IR-only sample at low current, red LED off, the chip shut down in between
+        static constexpr uint8_t PROBE_IR_PA = 0x0F;            // ~3 mA against ~22 mA at IR_PA_DEFAULT
+        static constexpr uint8_t PROBE_FIFO_CONFIG = 0x1F;      // No averaging, rollover
+        static constexpr uint8_t PROBE_SPO2_CONFIG = 0x47;      // 8192 nA, 100 sps, 411 us: same count scale as the profiles
+        static constexpr uint32_t PROBE_INTERVAL_MS = 1000;
+        static constexpr uint32_t PROBE_WAIT_MS = 50;           // Wake-up plus one sample period
+        // The finger-on IR level scaled to the probe current
+        static constexpr uint32_t PROBE_IR_MIN = PpgPipeline<AcquisitionProfile::STANDARD>::IR_MIN * PROBE_IR_PA / IR_PA_DEFAULT;
 
     // Interrupt enable
         static constexpr uint8_t INTR_EN_1 = 0x02;              // Interrupt enable 1 register
@@ -68,9 +102,12 @@ namespace devices {
         static constexpr uint8_t OVER_FLOW_COUNTER = 0x05;      // Over flow counter register
         static constexpr uint8_t FIFO_READ_PTR = 0x06;          // FIFO read pointer register
         static constexpr uint8_t FIFO_DATA = 0x07;              // FIFO data register
+        static constexpr uint8_t FIFO_DEPTH = 32;               // Samples
+        static constexpr uint8_t SAMPLE_BYTES = 6;              // 3 bytes per LED, 2 LEDs
 
     // FIFO configuration
         static constexpr uint8_t FIFO_CONFIG = 0x08;            // FIFO configuration register
+        static constexpr uint8_t FIFO_A_FULL_MASK = 0x0F;       // Free slots left when the almost-full interrupt fires
 
     // Mode configuration
         static constexpr uint8_t MODE_CONFIG = 0x09;            // Mode configuration register
@@ -97,22 +134,32 @@ namespace devices {
         i2c_port_num_t i2c_port_num_;
         uint16_t device_address_;
         uint32_t i2c_freq_hz_;
+        gpio_num_t intr_pin_;
         EnableLog show_values_log_;
+        FifoMode fifo_mode_;
         i2c_master_dev_handle_t dev_handle_;
 
         uint8_t trans_buf_[2];
-        uint8_t recv_buf_;
-
-        std::vector<uint32_t> ir_cache_;
-        std::vector<uint32_t> red_cache_;
-        static bool new_val;
-        static bool new_val1;
-
-        // Timer
-        esp_timer_handle_t start_timer_ = nullptr;
-        bool timer_on_1_ = false;
-
-        static void enable_timer_callback(void *pvParameters);
+        uint8_t fifo_buf_[FIFO_DEPTH * SAMPLE_BYTES];
+
+        PpgProcessor ppg_;
+        std::atomic<AcquisitionProfile> requested_profile_;     // Set from any task, applied by the sensor task
+        std::atomic<HrEngine> requested_engine_{HrEngine::WINDOWED};    // Same, at a window boundary
+        LedAgc led_agc_{RED_PA_DEFAULT, IR_PA_DEFAULT};
+        bool agc_pending_ = false;          // New amplitudes computed, written after the current batch
+        bool led_changed_ = false;          // Next sample is the first one at the new amplitudes
+        core::ResultChannel<Vitals> vitals_;
+        core::ResultChannel<BeatEvent> beats_;      // Every detected beat, by value
+        const MotionHistory *motion_ = nullptr;
+        protocols::WaveformStream *waveform_ = nullptr;
+
+        // Sample-index time: FIFO batches stamped in the ISR, windows closed by sample time
+        common::SampleClock clock_;
+        uint32_t intr_taken_ = 0;           // intr_stamp_ count already used
+        int64_t window_end_us_ = 0;         // 0: set from the next sample
+
+        FingerPresence presence_{PROBE_IR_MIN, 1000LL * MAX30102_ABSENCE_TIMEOUT_MS};
+        bool absence_pending_ = false;      // Timeout hit inside a batch, acquisition stops after it
 
     }; // class MAX30102
 
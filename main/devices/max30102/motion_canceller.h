@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cmath>
+#include <type_traits>
+
+#include "biquad.h"
+
+namespace devices {
+    // Normalized LMS noise canceller with the accelerometer as the noise reference.
+    // The reference goes through the same band-pass as the PPG, then TAPS delayed copies of each axis
+    // predict the motion component of the red and IR channels, which is subtracted.
+    // Float on purpose: 2 x 3 x TAPS multiply-adds per sample, well inside the budget on the ESP32 FPU.
+    template <size_t TAPS>
+    class MotionCanceller {
+    public:
+        static constexpr size_t AXES = 3;
+        static constexpr size_t WEIGHTS = TAPS * AXES;
+        static constexpr float STEP = 0.02f;            // NLMS step size, 0 < STEP < 2
+        static constexpr float REF_FLOOR = 10000.0f;    // Per-tap reference power (100 LSB rms, 0.05 g), below it the weights barely move
+
+        explicit MotionCanceller(const std::array<Biquad, 3> &band)
+                                : ref_filter_{BiquadCascade<float, 3>(band), BiquadCascade<float, 3>(band), BiquadCascade<float, 3>(band)} {}
+
+        // red / ir are band-passed PPG samples, replaced by the motion-free estimate
+        template <typename T>
+        void process(T &red, T &ir, const float accel[AXES]) {
+            for (size_t a = 0; a < AXES; a++) {
+                if (!primed_) ref_filter_[a].reset(accel[a]);
+                for (size_t k = TAPS - 1; k > 0; k--) ref_[a * TAPS + k] = ref_[a * TAPS + k - 1];
+                ref_[a * TAPS] = ref_filter_[a].process(accel[a]);
+            }
+            primed_ = true;
+
+            float power = REF_FLOOR * WEIGHTS;
+            float red_est = 0, ir_est = 0;
+            for (size_t i = 0; i < WEIGHTS; i++) {
+                power += ref_[i] * ref_[i];
+                red_est += red_w_[i] * ref_[i];
+                ir_est += ir_w_[i] * ref_[i];
+            }
+
+            float red_err = static_cast<float>(red) - red_est;
+            float ir_err = static_cast<float>(ir) - ir_est;
+            float red_gain = STEP * red_err / power;
+            float ir_gain = STEP * ir_err / power;
+            for (size_t i = 0; i < WEIGHTS; i++) {
+                red_w_[i] += red_gain * ref_[i];
+                ir_w_[i] += ir_gain * ref_[i];
+            }
+
+            red = from_float<T>(red_err);
+            ir = from_float<T>(ir_err);
+        }
+
+        void reset() {
+            for (auto &f : ref_filter_) f.reset();
+            ref_.fill(0);
+            red_w_.fill(0);
+            ir_w_.fill(0);
+            primed_ = false;
+        }
+
+    private:
+        template <typename T>
+        static T from_float(float v) {
+            if constexpr (std::is_floating_point_v<T>) return v;
+            else return static_cast<T>(std::lround(v));
+        }
+
+        BiquadCascade<float, 3> ref_filter_[AXES];
+        std::array<float, WEIGHTS> ref_ = {};           // Per axis, newest first
+        std::array<float, WEIGHTS> red_w_ = {};
+        std::array<float, WEIGHTS> ir_w_ = {};
+        bool primed_ = false;
+
+    }; // class MotionCanceller
+
+} // namespace devices
@@ -0,0 +1,214 @@
+#include "ppg_processor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace devices {
+    template <AcquisitionProfile P>
+    PpgEvent PpgPipeline<P>::push(uint32_t red, uint32_t ir, int64_t time_us, bool resync, const MotionRef *motion) {
+        if (red < RED_MIN || ir < IR_MIN) {
+            reset(time_us);
+            return PpgEvent::NO_FINGER;
+        }
+
+        if (!filter_primed_) {
+            filter_primed_ = true;
+            ir_filter_.reset(to_filter_units(ir));
+            red_filter_.reset(to_filter_units(red));
+        } else if (resync) {
+            // Treat the step across an LED current change as a DC shift instead of restarting
+            ir_filter_.shift(to_filter_units(ir) - to_filter_units(last_ir_));
+            red_filter_.shift(to_filter_units(red) - to_filter_units(last_red_));
+            if (!motion_active_) {
+                beat_detector_.shift(static_cast<float>(red) - static_cast<float>(last_red_));
+                beat_smoothing_.clear();        // Restart the average so the step is seen in one sample
+                beat_sum_ = 0;
+            }
+        }
+        last_red_ = red;
+        last_ir_ = ir;
+
+        ir_cache_.push(ir);
+        red_cache_.push(red);
+        ppg_sample_t ir_filt = ir_filter_.process(to_filter_units(ir));
+        ppg_sample_t red_filt = red_filter_.process(to_filter_units(red));
+        if (motion) {
+            if (!motion_active_) {
+                // The detector input changes scale, start it over
+                beat_detector_.reset();
+                beat_smoothing_.clear();
+                beat_sum_ = 0;
+                motion_active_ = true;
+            }
+            motion_canceller_.process(red_filt, ir_filt, motion->accel);
+        }
+        ir_filt_cache_.push(ir_filt);
+        red_filt_cache_.push(red_filt);
+        resync_cache_.push(resync);
+        quality_.add_sample(red, ir, static_cast<float>(to_ac_units(ir_filt)) / (1 << FILTER_FRAC));
+
+        // Raw red carries the motion artifact, so with a reference the detector follows the cleaned band-passed signal
+        if (motion_active_) red = static_cast<uint32_t>(std::max<int32_t>(0, MOTION_BEAT_BIAS + to_ac_units(red_filt)));
+
+        if constexpr (Traits::BEAT_SMOOTHING > 1) {
+            if (beat_smoothing_.full()) beat_sum_ -= beat_smoothing_[0];
+            beat_smoothing_.push(red);
+            beat_sum_ += red;
+            red = beat_sum_ / beat_smoothing_.size();
+        }
+        if (!beat_detector_.update(red, time_us)) return PpgEvent::SAMPLE;
+
+        quality_.add_beat(beat_detector_.last_beat().interval_us);
+        hrv_.add_interval(beat_detector_.last_beat().interval_us);
+        return PpgEvent::BEAT;
+    }
+
+    template <AcquisitionProfile P>
+    void PpgPipeline<P>::reset(int64_t now_us) {
+        clear_window();
+        filter_primed_ = false;
+        beat_detector_.reset();
+        beat_smoothing_.clear();
+        beat_sum_ = 0;
+        motion_canceller_.reset();
+        motion_active_ = false;
+        quality_.reset();
+        quality_report_ = {};
+        hrv_.reset();
+        hrv_report_ = {};
+        hrv_start_us_ = now_us;
+        spectral_.reset();
+
+        last_time_beat_ = now_us;
+        last_last_time_beat_ = 0;
+        final_last_time_beat_ = 0;
+    }
+
+    template <AcquisitionProfile P>
+    void PpgPipeline<P>::clear_window() {
+        ir_cache_.clear();
+        red_cache_.clear();
+        ir_filt_cache_.clear();
+        red_filt_cache_.clear();
+        resync_cache_.clear();
+    }
+
+    template <AcquisitionProfile P>
+    ppg_sample_t PpgPipeline<P>::to_filter_units(uint32_t sample) {
+        if constexpr (std::is_same_v<ppg_sample_t, float>) return static_cast<float>(sample) * (1 << FILTER_FRAC);
+        else return static_cast<int32_t>(sample << FILTER_FRAC);
+    }
+
+    template <AcquisitionProfile P>
+    int32_t PpgPipeline<P>::to_ac_units(ppg_sample_t value) {
+        if constexpr (std::is_same_v<ppg_sample_t, float>) return static_cast<int32_t>(std::lround(value));
+        else return value;
+    }
+
+    template <AcquisitionProfile P>
+    bool PpgPipeline<P>::caculate(int64_t now_us) {
+        int filter = Traits::EXTREMUM_RADIUS;
+        uint64_t beat = 0;
+        common::BoundedSample<float, MAX_WINDOW_BEATS> spo2_cache;     // On the stack, no heap in the sensor task
+        bool has_low = false;
+        ppg_sample_t low_red = 0;
+        ppg_sample_t low_ir = 0;
+
+        // Extrema come from the band-passed signal, DC from the raw counts at the peak
+        auto red = red_filt_cache_.view();
+        auto ir = ir_filt_cache_.view();
+        auto red_raw = red_cache_.view();
+        auto ir_raw = ir_cache_.view();
+        auto resync = resync_cache_.view();
+        quality_report_ = quality_.finish();
+        hrv_.end_window(quality_report_.score >= VITALS_QUALITY_MIN);
+        if (now_us - hrv_start_us_ >= HRV_PERIOD_US) {
+            hrv_report_ = hrv_.finish(now_us);
+            hrv_start_us_ = now_us;
+        }
+        if (red.size() <= (size_t)(2 * filter)) {
+            clear_window();
+            return false;
+        }
+
+        for (int i = filter; i < (int)red.size() - filter; i++) {
+            uint8_t var1 = 0;
+            uint8_t var2 = 0;
+
+            // AC amplitude changes with LED current, so no trough-to-peak pair may straddle a change
+            if (resync[i]) has_low = false;
+
+            for (int j = -filter; j < filter + 1; j++) {
+                if (red[i] < red[i+j]) var1++;
+                else if (red[i] > red[i+j]) var2++;
+            }
+
+            if (var1 == filter * 2) {
+                has_low = true;
+                low_red = red[i];
+                low_ir = ir[i];
+            }
+
+            if (var2 == filter * 2) {
+                beat++;
+                if (has_low) {
+                    int32_t red_ac = to_ac_units(red[i] - low_red);
+                    int32_t ir_ac = to_ac_units(ir[i] - low_ir);
+
+                    Spo2Ratio<spo2_num_t> ratio_of_ratios(uint64_t(red_raw[i]) << FILTER_FRAC, uint64_t(ir_raw[i]) << FILTER_FRAC, 1);
+                    spo2_num_t r = ratio_of_ratios.ratio(red_ac, ir_ac);
+
+                    float spo2_val = common::to_float(Spo2Ratio<spo2_num_t>::spo2(r));
+                    spo2_cache.push(spo2_val);
+                }
+                has_low = false;
+            }
+        }
+
+        // A noisy window would drag the smoothed value for several windows, so it does not feed it
+        if (!spo2_cache.empty() && quality_report_.score >= VITALS_QUALITY_MIN) {
+            float spo2_robust = spo2_cache.trimmed_mean(SPO2_TRIM);
+            spo2_filtered_ = std::min(100.0f, spo2_filtered_ * 0.8f + spo2_robust * 0.23f);
+            spo2_ = spo2_filtered_;
+        }
+
+        if (spectral_enabled_) spectral_.estimate(ir, SAMPLE_RATE_HZ);
+
+        if (!last_last_time_beat_) windowed_bpm_ = beat * 60 * 1000000 / (now_us - last_time_beat_);
+        else if (!final_last_time_beat_) windowed_bpm_ = (beat + last_beat_) * 60 * 1000000 / (now_us - last_last_time_beat_);
+        else windowed_bpm_ = (beat + last_beat_ + last_last_beat_) * 60 * 1000000 / (now_us - final_last_time_beat_);
+
+        if (quality_report_.score < VITALS_QUALITY_MIN) {
+            // Keep a bad window out of the next windows' average
+            last_last_time_beat_ = 0;
+            final_last_time_beat_ = 0;
+            last_time_beat_ = now_us;
+        } else {
+            last_last_beat_ = last_beat_;
+            last_beat_ = beat;
+
+            final_last_time_beat_ = last_last_time_beat_;
+            last_last_time_beat_ = last_time_beat_;
+            last_time_beat_ = now_us;
+        }
+
+        clear_window();
+        return true;
+    }
+
+    template class PpgPipeline<AcquisitionProfile::LOW_POWER>;
+    template class PpgPipeline<AcquisitionProfile::STANDARD>;
+    template class PpgPipeline<AcquisitionProfile::HIGH_RESOLUTION>;
+
+    void PpgProcessor::set_profile(AcquisitionProfile profile, int64_t now_us) {
+        profile_ = profile;
+        profile_config_ = profile_config(profile);
+
+        switch (profile) {
+            case AcquisitionProfile::LOW_POWER: pipeline_.emplace<PpgPipeline<AcquisitionProfile::LOW_POWER>>(now_us); break;
+            case AcquisitionProfile::HIGH_RESOLUTION: pipeline_.emplace<PpgPipeline<AcquisitionProfile::HIGH_RESOLUTION>>(now_us); break;
+            default: pipeline_.emplace<PpgPipeline<AcquisitionProfile::STANDARD>>(now_us); break;
+        }
+        set_engine(engine_);
+    }
+
+} // namespace devices
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <variant>
+
+#include "common/config.h"
+#include "common/ring_buffer.h"
+#include "common/bounded_sample.h"
+#include "beat_detector.h"
+#include "spo2.h"
+#include "biquad.h"
+#include "acquisition_profile.h"
+#include "motion_canceller.h"
+#include "signal_quality.h"
+#include "hrv.h"
+#include "spectral_hr.h"
+
+namespace devices {
+    enum class HrEngine {
+        WINDOWED = 0,       // Extremum count over the FILTER_TIME window
+        STREAMING,          // Per-sample BeatDetector, updated on every beat
+        SPECTRAL            // Spectral peak of each window, tracked across windows
+    };
+
+    enum class PpgEvent {
+        NO_FINGER = 0,      // Sample rejected, window and detectors restarted
+        SAMPLE,
+        BEAT
+    };
+
+    // Mean accelerometer reading (raw LSB) over the interval of one PPG sample, on the same timebase
+    struct MotionRef {
+        float accel[3];
+    };
+
+#if MAX30102_SPO2_FIXED_POINT
+    using spo2_num_t = Q24;
+#else
+    using spo2_num_t = float;
+#endif
+
+#if MAX30102_FILTER_FIXED_POINT
+    using ppg_sample_t = int32_t;
+#else
+    using ppg_sample_t = float;
+#endif
+
+    // MAX30102 signal processing with no FreeRTOS / IDF dependency, so it also builds on the host (tools/ppg_replay).
+    // Everything that depends on the effective sample rate comes from ProfileTraits<P> at compile time.
+    template <AcquisitionProfile P>
+    class PpgPipeline {
+    public:
+        using Traits = ProfileTraits<P>;
+        static constexpr size_t MAX_CACHE_SIZE = Traits::MAX_CACHE_SIZE;
+        static constexpr float SAMPLE_RATE_HZ = Traits::SAMPLE_RATE_HZ;
+        static constexpr int64_t SAMPLE_PERIOD_US = static_cast<int64_t>(1000000 / SAMPLE_RATE_HZ);
+        static constexpr int FILTER_FRAC = 4;                       // Filtered samples are in 1/16 ADC counts
+        static constexpr auto PPG_BANDPASS = ppg_bandpass(SAMPLE_RATE_HZ);
+
+        static constexpr uint32_t RED_MIN = 80000;                  // Finger-on DC levels
+        static constexpr uint32_t IR_MIN = 60000;
+        static constexpr int32_t MOTION_BEAT_BIAS = 1 << 22;        // Lifts the cleaned AC signal into the BeatDetector's unsigned input
+        static constexpr size_t MAX_WINDOW_BEATS = 64;              // Per-beat SpO2 values kept per window, 250 bpm over 15 s
+        static constexpr float SPO2_TRIM = 0.25f;                   // Interquartile mean of the per-beat values
+        static constexpr int64_t HRV_PERIOD_US = 60000000;          // Short-term HRV, reported at the first window end after it
+
+        static_assert(MAX_CACHE_SIZE * SAMPLE_PERIOD_US > Traits::WINDOW_MS * 1000LL, "Cache shorter than the window");
+
+        explicit PpgPipeline(int64_t now_us = 0) { reset(now_us); }
+
+        PpgEvent push(uint32_t red, uint32_t ir, int64_t time_us, bool resync = false, const MotionRef *motion = nullptr);
+        bool caculate(int64_t now_us);
+        void reset(int64_t now_us);
+
+        bool motion_active() const { return motion_active_; }
+        const SignalQualityReport &get_quality() const { return quality_report_; }
+        const HrvReport &get_hrv() const { return hrv_report_; }
+        int get_windowed_bpm() const { return windowed_bpm_; }
+        int get_spectral_bpm() const { return spectral_.get_bpm(); }
+        void set_spectral(bool enabled) { spectral_enabled_ = enabled; }     // The FFT only runs for the spectral engine
+        float get_spo2() const { return spo2_; }
+        const BeatDetector &get_beat_detector() const { return beat_detector_; }
+
+        static ppg_sample_t to_filter_units(uint32_t sample);
+        static int32_t to_ac_units(ppg_sample_t value);
+
+    private:
+        common::RingBuffer<uint32_t, MAX_CACHE_SIZE> ir_cache_;
+        common::RingBuffer<uint32_t, MAX_CACHE_SIZE> red_cache_;
+        common::RingBuffer<ppg_sample_t, MAX_CACHE_SIZE> ir_filt_cache_;
+        common::RingBuffer<ppg_sample_t, MAX_CACHE_SIZE> red_filt_cache_;
+        common::RingBuffer<bool, MAX_CACHE_SIZE> resync_cache_;       // LED current changed before this sample
+        BiquadCascade<ppg_sample_t, PPG_BANDPASS.size()> ir_filter_{PPG_BANDPASS};
+        BiquadCascade<ppg_sample_t, PPG_BANDPASS.size()> red_filter_{PPG_BANDPASS};
+        bool filter_primed_ = false;
+        uint32_t last_red_ = 0;
+        uint32_t last_ir_ = 0;
+        BeatDetector beat_detector_{SAMPLE_RATE_HZ};
+        common::RingBuffer<uint32_t, Traits::BEAT_SMOOTHING> beat_smoothing_;
+        uint32_t beat_sum_ = 0;
+        MotionCanceller<Traits::MOTION_TAPS> motion_canceller_{PPG_BANDPASS};
+        bool motion_active_ = false;        // A reference was seen since the last reset, beats come from the cleaned signal
+        SignalQuality quality_;
+        SignalQualityReport quality_report_ = {};     // Of the last finished window
+        HrvStats hrv_;
+        HrvReport hrv_report_ = {};                   // Of the last finished period
+        int64_t hrv_start_us_ = 0;
+        SpectralHr<Traits::SPECTRAL_SIZE, Traits::SPECTRAL_DECIMATION> spectral_;
+        bool spectral_enabled_ = false;
+
+        // Windowed BPM spans up to the last three windows
+        int64_t last_time_beat_ = 0;
+        int64_t last_last_time_beat_ = 0;
+        int64_t final_last_time_beat_ = 0;
+        uint64_t last_beat_ = 0;
+        uint64_t last_last_beat_ = 0;
+
+        int windowed_bpm_ = 0;
+        float spo2_ = 0;
+        float spo2_filtered_ = 97.0f;
+
+        void clear_window();
+
+    }; // class PpgPipeline
+
+    extern template class PpgPipeline<AcquisitionProfile::LOW_POWER>;
+    extern template class PpgPipeline<AcquisitionProfile::STANDARD>;
+    extern template class PpgPipeline<AcquisitionProfile::HIGH_RESOLUTION>;
+
+    // Holds the pipeline of the active profile; switching rebuilds it in place (no heap, sized for the largest profile).
+    class PpgProcessor {
+    public:
+        explicit PpgProcessor(AcquisitionProfile profile = AcquisitionProfile::STANDARD, int64_t now_us = 0) { set_profile(profile, now_us); }
+
+        void set_profile(AcquisitionProfile profile, int64_t now_us);
+        AcquisitionProfile get_profile() const { return profile_; }
+        const ProfileConfig &get_profile_config() const { return profile_config_; }
+
+        PpgEvent push(uint32_t red, uint32_t ir, int64_t time_us, bool resync = false, const MotionRef *motion = nullptr) {
+            return std::visit([&](auto &p) { return p.push(red, ir, time_us, resync, motion); }, pipeline_);
+        }
+        bool caculate(int64_t now_us) { return std::visit([&](auto &p) { return p.caculate(now_us); }, pipeline_); }
+        void reset(int64_t now_us) { std::visit([&](auto &p) { p.reset(now_us); }, pipeline_); }
+
+        int get_heart_rate() const {
+            switch (engine_) {
+                case HrEngine::STREAMING: return get_beat_detector().get_heart_rate();
+                case HrEngine::SPECTRAL: return get_spectral_bpm();
+                default: return get_windowed_bpm();
+            }
+        }
+        int get_windowed_bpm() const { return std::visit([](const auto &p) { return p.get_windowed_bpm(); }, pipeline_); }
+        int get_spectral_bpm() const { return std::visit([](const auto &p) { return p.get_spectral_bpm(); }, pipeline_); }
+        float get_spo2() const { return std::visit([](const auto &p) { return p.get_spo2(); }, pipeline_); }
+        bool motion_active() const { return std::visit([](const auto &p) { return p.motion_active(); }, pipeline_); }
+        const SignalQualityReport &get_quality() const {
+            return std::visit([](const auto &p) -> const SignalQualityReport & { return p.get_quality(); }, pipeline_);
+        }
+        const HrvReport &get_hrv() const {
+            return std::visit([](const auto &p) -> const HrvReport & { return p.get_hrv(); }, pipeline_);
+        }
+        const BeatDetector &get_beat_detector() const {
+            return std::visit([](const auto &p) -> const BeatDetector & { return p.get_beat_detector(); }, pipeline_);
+        }
+        void set_engine(HrEngine engine) {
+            engine_ = engine;
+            std::visit([&](auto &p) { p.set_spectral(engine == HrEngine::SPECTRAL); }, pipeline_);
+        }
+        HrEngine get_engine() const { return engine_; }
+
+    private:
+        std::variant<PpgPipeline<AcquisitionProfile::LOW_POWER>,
+                     PpgPipeline<AcquisitionProfile::STANDARD>,
+                     PpgPipeline<AcquisitionProfile::HIGH_RESOLUTION>> pipeline_;
+        AcquisitionProfile profile_ = AcquisitionProfile::STANDARD;
+        ProfileConfig profile_config_ = profile_config(AcquisitionProfile::STANDARD);
+        HrEngine engine_ = HrEngine::WINDOWED;
+
+    }; // class PpgProcessor
+
+} // namespace devices
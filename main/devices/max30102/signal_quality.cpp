@@ -0,0 +1,59 @@
+#include "signal_quality.h"
+#include <algorithm>
+#include <cmath>
+
+namespace devices {
+    void SignalQuality::add_sample(uint32_t red, uint32_t ir, float ir_ac) {
+        if (red >= CLIP_HIGH || ir >= CLIP_HIGH) clipped_++;
+        if (ir) {
+            float ratio = ir_ac / static_cast<float>(ir);
+            ac_ratio_sq_sum_ += ratio * ratio;
+        }
+        samples_++;
+    }
+
+    void SignalQuality::add_beat(int64_t interval_us) {
+        if (!interval_us) return;
+
+        float interval_ms = interval_us / 1000.0f;
+        intervals_++;
+        float delta = interval_ms - interval_mean_;
+        interval_mean_ += delta / intervals_;
+        interval_m2_ += delta * (interval_ms - interval_mean_);
+    }
+
+    SignalQualityReport SignalQuality::finish() {
+        SignalQualityReport report = {0, 0, -1, clipped_, samples_};
+
+        if (samples_) {
+            // Peak-to-peak of a sinusoid is 2 * sqrt(2) * rms
+            report.perfusion_index = 100.0f * 2.8284271f * std::sqrt(ac_ratio_sq_sum_ / samples_);
+        }
+        if (intervals_ >= 2 && interval_mean_ > 0) {
+            report.interval_cv = std::sqrt(interval_m2_ / (intervals_ - 1)) / interval_mean_;
+        }
+
+        float perfusion = std::min(ramp(report.perfusion_index, PI_LOW, PI_GOOD), ramp(report.perfusion_index, PI_HIGH, PI_SUSPECT));
+        float regularity = report.interval_cv < 0 ? 0.0f : ramp(report.interval_cv, CV_BAD, CV_GOOD);
+        float clipping = samples_ ? ramp(static_cast<float>(clipped_) / samples_, CLIP_BAD, 0) : 0.0f;
+        report.score = static_cast<uint8_t>(std::lround(100.0f * perfusion * regularity * clipping));
+
+        reset();
+        return report;
+    }
+
+    void SignalQuality::reset() {
+        ac_ratio_sq_sum_ = 0;
+        samples_ = 0;
+        clipped_ = 0;
+        intervals_ = 0;
+        interval_mean_ = 0;
+        interval_m2_ = 0;
+    }
+
+    // 0 at zero_at, 1 at one_at, clamped; either direction
+    float SignalQuality::ramp(float x, float zero_at, float one_at) {
+        return std::clamp((x - zero_at) / (one_at - zero_at), 0.0f, 1.0f);
+    }
+
+} // namespace devices
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+namespace devices {
+    struct SignalQualityReport {
+        uint8_t score;              // 0 (unusable) .. 100
+        float perfusion_index;      // IR AC / DC, %
+        float interval_cv;          // Beat interval standard deviation / mean, -1 with fewer than 2 intervals
+        uint16_t clipped;           // Samples at the ADC limits
+        uint16_t samples;
+    };
+
+    // Per-window signal quality, accumulated sample by sample in constant memory:
+    // perfusion index, beat interval regularity and clipping each give a factor in [0, 1], the score is their product.
+    class SignalQuality {
+    public:
+        static constexpr uint32_t CLIP_HIGH = 0x3FF00;          // 18-bit full scale is 0x3FFFF
+        static constexpr float PI_LOW = 0.1f;                   // %, no usable pulse below
+        static constexpr float PI_GOOD = 0.5f;
+        static constexpr float PI_SUSPECT = 10.0f;              // Larger swings are pressure or motion, not perfusion
+        static constexpr float PI_HIGH = 20.0f;
+        static constexpr float CV_GOOD = 0.10f;
+        static constexpr float CV_BAD = 0.35f;
+        static constexpr float CLIP_BAD = 0.05f;                // Fraction of clipped samples
+
+        void add_sample(uint32_t red, uint32_t ir, float ir_ac);
+        void add_beat(int64_t interval_us);
+        SignalQualityReport finish();                           // Report for the window so far, then start a new one
+        void reset();
+
+    private:
+        static float ramp(float x, float zero_at, float one_at);
+
+        float ac_ratio_sq_sum_ = 0;         // (AC / DC)^2 per sample, invariant to LED current changes
+        uint16_t samples_ = 0;
+        uint16_t clipped_ = 0;
+
+        // Welford over beat intervals, in ms
+        uint16_t intervals_ = 0;
+        float interval_mean_ = 0;
+        float interval_m2_ = 0;
+
+    }; // class SignalQuality
+
+} // namespace devices
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <span>
+#include <utility>
+
+namespace devices {
+    // In-place radix-2 FFT of N real samples through an N/2 point complex FFT and a split pass.
+    // Output is packed in the input array: [0] DC, [1] Nyquist, [2k] / [2k + 1] real / imaginary part of bin k.
+    // One twiddle table per N, built on first use and shared by every instance.
+    template <size_t N>
+    class RealFft {
+    public:
+        static_assert(N >= 4 && (N & (N - 1)) == 0, "RealFft size must be a power of two");
+        static constexpr size_t HALF = N / 2;
+
+        static void forward(float *data) {
+            const Twiddles &tw = twiddles();
+
+            // Even / odd samples as the real / imaginary parts of HALF complex values
+            for (size_t i = 1, j = 0; i < HALF; i++) {
+                size_t bit = HALF >> 1;
+                for (; j & bit; bit >>= 1) j ^= bit;
+                j |= bit;
+                if (i < j) {
+                    std::swap(data[2 * i], data[2 * j]);
+                    std::swap(data[2 * i + 1], data[2 * j + 1]);
+                }
+            }
+
+            for (size_t len = 2; len <= HALF; len <<= 1) {
+                size_t stride = N / len;
+                for (size_t start = 0; start < HALF; start += len) {
+                    for (size_t k = 0; k < len / 2; k++) {
+                        float wr = tw.re[k * stride], wi = tw.im[k * stride];
+                        float *a = data + 2 * (start + k);
+                        float *b = data + 2 * (start + k + len / 2);
+                        float br = b[0] * wr - b[1] * wi;
+                        float bi = b[0] * wi + b[1] * wr;
+                        b[0] = a[0] - br;
+                        b[1] = a[1] - bi;
+                        a[0] += br;
+                        a[1] += bi;
+                    }
+                }
+            }
+
+            // Split: X[k] = E[k] + W^k O[k], X[HALF - k] = conj(E[k] - W^k O[k])
+            float dc = data[0];
+            data[0] = dc + data[1];
+            data[1] = dc - data[1];
+            for (size_t k = 1; k <= HALF / 2; k++) {
+                float *zk = data + 2 * k;
+                float *zm = data + 2 * (HALF - k);
+                float er = 0.5f * (zk[0] + zm[0]), ei = 0.5f * (zk[1] - zm[1]);
+                float orr = 0.5f * (zk[1] + zm[1]), oi = -0.5f * (zk[0] - zm[0]);
+                float tr = orr * tw.re[k] - oi * tw.im[k];
+                float ti = orr * tw.im[k] + oi * tw.re[k];
+                zk[0] = er + tr;
+                zk[1] = ei + ti;
+                zm[0] = er - tr;
+                zm[1] = ti - ei;
+            }
+        }
+
+    private:
+        struct Twiddles {
+            float re[HALF];
+            float im[HALF];
+
+            Twiddles() {
+                for (size_t k = 0; k < HALF; k++) {
+                    double angle = -2.0 * M_PI * k / N;
+                    re[k] = static_cast<float>(std::cos(angle));
+                    im[k] = static_cast<float>(std::sin(angle));
+                }
+            }
+        };
+
+        static const Twiddles &twiddles() {
+            static const Twiddles table;
+            return table;
+        }
+
+    }; // class RealFft
+
+    // Heart rate from the strongest pulse harmonic in 0.5 - 4 Hz, robust to missed or extra peaks.
+    // The window is Hann-weighted and zero-padded to N, each candidate bin scores its power plus its 2nd harmonic's
+    // (so the fundamental beats a strong 2nd harmonic), candidates far from the rate tracked over the previous
+    // windows are discounted, and the winning bin is refined by a parabola through its log powers.
+    template <size_t N, size_t DECIMATION>
+    class SpectralHr {
+    public:
+        static constexpr float BAND_LOW_HZ = 0.5f;
+        static constexpr float BAND_HIGH_HZ = 4.0f;
+        static constexpr float TRACK_BPM = 25.0f;          // Half-weight distance from the tracked rate
+        static constexpr float MIN_PEAK_SHARE = 0.15f;     // Of the band power, below it there is no clear pulse
+        static constexpr uint8_t MAX_MISSES = 3;           // Windows without a clear pulse before tracking restarts
+
+        // Input samples at input_rate_hz, decimated by DECIMATION; 0 when the spectrum has no clear peak
+        template <typename T>
+        int estimate(std::span<const T> samples, float input_rate_hz) {
+            size_t count = std::min(samples.size() / DECIMATION, N);
+            if (count < 8) return miss();
+            samples = samples.subspan(samples.size() - count * DECIMATION);
+
+            float mean = 0;
+            for (size_t i = 0; i < count; i++) {
+                float sum = 0;
+                for (size_t d = 0; d < DECIMATION; d++) sum += static_cast<float>(samples[i * DECIMATION + d]);
+                data_[i] = sum / DECIMATION;
+                mean += data_[i];
+            }
+            mean /= count;
+            for (size_t i = 0; i < count; i++) {
+                data_[i] = (data_[i] - mean) * (0.5f - 0.5f * std::cos(2.0f * static_cast<float>(M_PI) * i / (count - 1)));
+            }
+            for (size_t i = count; i < N; i++) data_[i] = 0;
+
+            RealFft<N>::forward(data_);
+
+            float bin_hz = input_rate_hz / DECIMATION / N;
+            size_t low = std::max<size_t>(1, static_cast<size_t>(BAND_LOW_HZ / bin_hz));
+            size_t high = std::min(N / 2 - 2, static_cast<size_t>(BAND_HIGH_HZ / bin_hz) + 1);
+            float band_power = 0;
+            for (size_t k = low; k <= high; k++) band_power += power(k);
+
+            size_t best = 0;
+            float best_score = 0, best_power = 0;
+            for (size_t k = low + 1; k < high; k++) {
+                float p = power(k);
+                if (p < power(k - 1) || p < power(k + 1)) continue;
+
+                float score = p + (2 * k < N / 2 ? power(2 * k) : 0);
+                if (tracked_bpm_ > 0) {
+                    float distance = (k * bin_hz * 60 - tracked_bpm_) / TRACK_BPM;
+                    score /= 1 + distance * distance;
+                }
+                if (score > best_score) {
+                    best = k;
+                    best_score = score;
+                    best_power = p + power(k - 1) + power(k + 1);
+                }
+            }
+            if (!best || best_power < MIN_PEAK_SHARE * band_power) return miss();
+
+            float l = std::log(power(best - 1) + 1e-12f), c = std::log(power(best) + 1e-12f), r = std::log(power(best + 1) + 1e-12f);
+            float curvature = l - 2 * c + r;
+            float offset = curvature < 0 ? std::clamp(0.5f * (l - r) / curvature, -0.5f, 0.5f) : 0;
+
+            tracked_bpm_ = (best + offset) * bin_hz * 60;
+            misses_ = 0;
+            bpm_ = static_cast<int>(std::lround(tracked_bpm_));
+            return bpm_;
+        }
+
+        void reset() {
+            tracked_bpm_ = 0;
+            misses_ = 0;
+            bpm_ = 0;
+        }
+
+        int get_bpm() const { return bpm_; }
+
+    private:
+        float power(size_t k) const { return data_[2 * k] * data_[2 * k] + data_[2 * k + 1] * data_[2 * k + 1]; }
+
+        int miss() {
+            if (++misses_ >= MAX_MISSES) tracked_bpm_ = 0;
+            bpm_ = 0;
+            return 0;
+        }
+
+        float data_[N] = {};
+        float tracked_bpm_ = 0;
+        uint8_t misses_ = 0;
+        int bpm_ = 0;
+
+    }; // class SpectralHr
+
+} // namespace devices
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "common/fixed_point.h"
+
+namespace devices {
+    using Q24 = common::Fixed<24>;      // Q7.24: holds SpO2 up to 127 % and AC/DC ratios to 6e-8
+
+    // Ratio-of-ratios SpO2, one code path for float and Q24.
+    // Q24 matches float within 0.01 %SpO2 over the whole clamped R range.
+    template <typename T>
+    class Spo2Ratio {
+    public:
+        static constexpr float RATIO_MIN = 0.001f;          // AC/DC clamp per channel
+        static constexpr float RATIO_MAX = 0.0025f;
+
+        // DC levels come in as integer sums so no per-sample conversion is needed
+        Spo2Ratio(uint64_t red_sum, uint64_t ir_sum, size_t count)
+                    : red_sum_(red_sum), ir_sum_(ir_sum), count_(count) {}
+
+        T ratio(int32_t red_ac, int32_t ir_ac) const {
+            T red_ratio = std::clamp(common::from_ratio<T>(int64_t(red_ac) * count_, red_sum_), T(RATIO_MIN), T(RATIO_MAX));
+            T ir_ratio  = std::clamp(common::from_ratio<T>(int64_t(ir_ac) * count_, ir_sum_), T(RATIO_MIN), T(RATIO_MAX));
+            return red_ratio / ir_ratio;
+        }
+
+        // SpO2 = 110 - 25 * R, tabulated at compile time and linearly interpolated
+        static T spo2(T r) {
+            r = std::clamp(r, T(R_MIN), T(R_MAX));
+            T pos = (r - T(R_MIN)) * T(STEPS_PER_UNIT);
+            int idx = std::min(common::to_int(pos), int(LUT_SIZE) - 2);
+            T frac = pos - T(idx);
+            return LUT[idx] + (LUT[idx + 1] - LUT[idx]) * frac;
+        }
+
+    private:
+        static constexpr float R_MIN = RATIO_MIN / RATIO_MAX;   // 0.4
+        static constexpr float R_MAX = RATIO_MAX / RATIO_MIN;   // 2.5
+        static constexpr int STEPS_PER_UNIT = 16;
+        static constexpr size_t LUT_SIZE = static_cast<size_t>((R_MAX - R_MIN) * STEPS_PER_UNIT) + 2;
+
+        static constexpr float curve(float r) { return 110.0f - 25.0f * r; }
+
+        static constexpr std::array<T, LUT_SIZE> make_lut() {
+            std::array<T, LUT_SIZE> lut{};
+            for (size_t i = 0; i < LUT_SIZE; i++) lut[i] = T(curve(R_MIN + static_cast<float>(i) / STEPS_PER_UNIT));
+            return lut;
+        }
+
+        static constexpr std::array<T, LUT_SIZE> LUT = make_lut();
+
+        uint64_t red_sum_;
+        uint64_t ir_sum_;
+        size_t count_;
+
+    }; // class Spo2Ratio
+
+} // namespace devices
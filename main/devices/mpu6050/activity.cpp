@@ -0,0 +1,107 @@
+#include "activity.h"
+#include <algorithm>
+#include <cmath>
+
+namespace devices {
+    bool ActivityMonitor::push(int64_t time_us, const int16_t accel[3]) {
+        float x = accel[0] / ACCEL_LSB_PER_G, y = accel[1] / ACCEL_LSB_PER_G, z = accel[2] / ACCEL_LSB_PER_G;
+        float magnitude = std::sqrt(x * x + y * y + z * z);
+
+        if (!started_) {
+            started_ = true;
+            last_us_ = time_us;
+            gravity_ = magnitude;
+            epoch_end_us_ = time_us + EPOCH_US;
+        }
+        float dt = static_cast<float>(std::clamp<int64_t>(time_us - last_us_, 0, SMOOTH_TAU_US));
+        last_us_ = time_us;
+
+        gravity_ += (magnitude - gravity_) * dt / GRAVITY_TAU_US;
+        smooth_ += (magnitude - gravity_ - smooth_) * dt / (SMOOTH_TAU_US + dt);
+        detect_step(time_us);
+
+        epoch_samples_++;
+        float delta = magnitude - epoch_mean_;
+        epoch_mean_ += delta / epoch_samples_;
+        epoch_m2_ += delta * (magnitude - epoch_mean_);
+
+        period_done_ = false;
+        if (time_us >= epoch_end_us_) {
+            // After a gap the epochs restart from this sample
+            epoch_end_us_ = time_us - epoch_end_us_ < EPOCH_US ? epoch_end_us_ + EPOCH_US : time_us + EPOCH_US;
+            end_epoch();
+            if (period_done_) report_.end_us = time_us;
+        }
+        return period_done_;
+    }
+
+    void ActivityMonitor::detect_step(int64_t time_us) {
+        float threshold = std::max(MIN_STEP_G, STEP_THRESHOLD * peak_level_);
+
+        if (smooth_ > threshold) {
+            if (!above_ || smooth_ > peak_) {
+                peak_ = smooth_;
+                peak_us_ = time_us;
+            }
+            above_ = true;
+            return;
+        }
+        if (!above_ || smooth_ > 0) return;
+
+        // Back through the baseline: the peak is complete
+        above_ = false;
+        if (step_us_ && peak_us_ - step_us_ < MIN_STEP_US) return;      // Heel-strike echo of the last step
+        peak_level_ += (peak_ - peak_level_) * 0.25f;
+        count_step(peak_us_);
+    }
+
+    void ActivityMonitor::count_step(int64_t time_us) {
+        if (!step_us_ || time_us - step_us_ > MAX_STEP_US) streak_ = 0;
+        step_us_ = time_us;
+
+        // The streak's first candidates are counted together once it is long enough
+        uint8_t counted = 0;
+        if (streak_ < MIN_STREAK && ++streak_ == MIN_STREAK) counted = MIN_STREAK;
+        else if (streak_ >= MIN_STREAK) counted = 1;
+
+        total_steps_ += counted;
+        period_steps_ += counted;
+        epoch_steps_ += counted;
+    }
+
+    void ActivityMonitor::end_epoch() {
+        float deviation = epoch_samples_ > 1 ? std::sqrt(epoch_m2_ / (epoch_samples_ - 1)) : 0;
+        float cadence = epoch_steps_ * 60000000.0f / EPOCH_US;
+
+        Activity activity = Activity::REST;
+        if (cadence >= RUN_CADENCE || (cadence >= WALK_CADENCE && deviation >= RUN_DEVIATION_G)) activity = Activity::RUN;
+        else if (cadence >= WALK_CADENCE) activity = Activity::WALK;
+        epochs_[static_cast<uint8_t>(activity)]++;
+
+        epoch_samples_ = 0;
+        epoch_mean_ = 0;
+        epoch_m2_ = 0;
+        epoch_steps_ = 0;
+        if (++period_epochs_ < EPOCHS_PER_PERIOD) return;
+
+        // Ties go to the more active label
+        uint8_t best = 0;
+        for (uint8_t i = 1; i < 3; i++) {
+            if (epochs_[i] >= epochs_[best]) best = i;
+        }
+        report_.steps = period_steps_;
+        report_.total_steps = total_steps_;
+        report_.activity = static_cast<Activity>(best);
+        std::copy(epochs_, epochs_ + 3, report_.epochs);
+
+        period_steps_ = 0;
+        period_epochs_ = 0;
+        std::fill(epochs_, epochs_ + 3, 0);
+        period_done_ = true;
+    }
+
+    void ActivityMonitor::reset() {
+        *this = ActivityMonitor();
+    }
+
+} // namespace devices
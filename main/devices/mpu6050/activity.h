@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include "imu_range.h"
+
+namespace devices {
+    enum class Activity : uint8_t {
+        REST = 0,           // No regular steps
+        WALK,
+        RUN
+    };
+
+    struct ActivityReport {
+        int64_t end_us;             // End of the period, 0 before the first report
+        uint32_t steps;             // Counted in the period
+        uint32_t total_steps;       // Since start
+        Activity activity;          // Most frequent epoch label of the period
+        uint8_t epochs[3];          // Epochs per Activity value
+    };
+
+    // Pedometer and rest / walk / run classifier on the accelerometer stream in constant memory.
+    // Steps are peaks of the gravity-free acceleration magnitude above an adaptive threshold; a candidate only
+    // counts once MIN_STREAK of them follow each other at step-like intervals, which rejects isolated jolts.
+    // Each epoch is labelled from its cadence and magnitude deviation, each period reports its steps and the
+    // most frequent label. Epochs and periods close on sample time.
+    class ActivityMonitor {
+    public:
+        static constexpr int64_t EPOCH_US = 5000000;
+        static constexpr uint8_t EPOCHS_PER_PERIOD = 12;        // 1 min reports
+
+        static constexpr int64_t GRAVITY_TAU_US = 1000000;      // Magnitude baseline
+        static constexpr int64_t SMOOTH_TAU_US = 40000;         // ~4 Hz low-pass against impact ringing
+        static constexpr float MIN_STEP_G = 0.1f;
+        static constexpr float STEP_THRESHOLD = 0.4f;           // Of the smoothed peak height
+        static constexpr int64_t MIN_STEP_US = 250000;          // 240 steps/min
+        static constexpr int64_t MAX_STEP_US = 2000000;         // Longer pauses restart the streak
+        static constexpr uint8_t MIN_STREAK = 4;
+
+        static constexpr float WALK_CADENCE = 30.0f;            // steps/min, below it an epoch is REST
+        static constexpr float RUN_CADENCE = 140.0f;
+        static constexpr float RUN_DEVIATION_G = 0.6f;          // Magnitude standard deviation
+
+        // True when the sample closed a period, report() then holds it
+        bool push(int64_t time_us, const int16_t accel[3]);
+        const ActivityReport &report() const { return report_; }
+        uint32_t total_steps() const { return total_steps_; }
+        void reset();
+
+    private:
+        void detect_step(int64_t time_us);
+        void count_step(int64_t time_us);
+        void end_epoch();
+
+        ActivityReport report_ = {};
+
+        // Step detection
+        bool started_ = false;
+        int64_t last_us_ = 0;
+        float gravity_ = 1.0f;
+        float smooth_ = 0;
+        float peak_level_ = 0;              // Smoothed height of the counted peaks
+        bool above_ = false;                // Inside a peak
+        float peak_ = 0;
+        int64_t peak_us_ = 0;
+        int64_t step_us_ = 0;               // Last candidate, 0 after a pause
+        uint8_t streak_ = 0;
+        uint32_t total_steps_ = 0;
+
+        // Epoch and period
+        int64_t epoch_end_us_ = 0;
+        uint16_t epoch_samples_ = 0;
+        float epoch_mean_ = 0;
+        float epoch_m2_ = 0;
+        uint16_t epoch_steps_ = 0;
+        uint32_t period_steps_ = 0;
+        uint8_t period_epochs_ = 0;
+        uint8_t epochs_[3] = {};
+        bool period_done_ = false;
+
+    }; // class ActivityMonitor
+
+} // namespace devices
@@ -0,0 +1,109 @@
+#include "attitude.h"
+#include <algorithm>
+#include <cmath>
+
+namespace devices {
+    static constexpr float DEG_PER_RAD = 180.0f / static_cast<float>(M_PI);
+
+    const Attitude &AttitudeEstimator::update(int64_t time_us, const int16_t accel[3], const int16_t gyro[3]) {
+        float ax = accel[0] / ACCEL_LSB_PER_G, ay = accel[1] / ACCEL_LSB_PER_G, az = accel[2] / ACCEL_LSB_PER_G;
+        float norm = std::sqrt(ax * ax + ay * ay + az * az);
+
+        int64_t step = time_us - attitude_.time_us;
+        attitude_.time_us = time_us;
+        if (!started_ || step <= 0 || step > MAX_STEP_US) {
+            if (norm > 0) align(ax, ay, az);
+            publish_angles();
+            return attitude_;
+        }
+        float dt = step * 1e-6f;
+        float gx = gyro[0] / (GYRO_LSB_PER_DPS * DEG_PER_RAD), gy = gyro[1] / (GYRO_LSB_PER_DPS * DEG_PER_RAD), gz = gyro[2] / (GYRO_LSB_PER_DPS * DEG_PER_RAD);
+        float *q = attitude_.q;
+
+        if (std::fabs(norm - 1.0f) < GRAVITY_GATE_G) {
+            ax /= norm;
+            ay /= norm;
+            az /= norm;
+
+            // Gravity direction predicted by the quaternion, the cross product is the rotation error
+            float vx = 2 * (q[1] * q[3] - q[0] * q[2]);
+            float vy = 2 * (q[0] * q[1] + q[2] * q[3]);
+            float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+            float ex = ay * vz - az * vy, ey = az * vx - ax * vz, ez = ax * vy - ay * vx;
+
+            constexpr float MAX_BIAS = MAX_BIAS_DPS / DEG_PER_RAD;
+            bias_[0] = std::clamp(bias_[0] + KI * ex * dt, -MAX_BIAS, MAX_BIAS);
+            bias_[1] = std::clamp(bias_[1] + KI * ey * dt, -MAX_BIAS, MAX_BIAS);
+            bias_[2] = std::clamp(bias_[2] + KI * ez * dt, -MAX_BIAS, MAX_BIAS);
+            gx += KP * ex + bias_[0];
+            gy += KP * ey + bias_[1];
+            gz += KP * ez + bias_[2];
+        }
+        else {
+            gx += bias_[0];
+            gy += bias_[1];
+            gz += bias_[2];
+        }
+
+        // q' = q + 0.5 q (0, w) dt
+        float hx = 0.5f * gx * dt, hy = 0.5f * gy * dt, hz = 0.5f * gz * dt;
+        float w = q[0], x = q[1], y = q[2], z = q[3];
+        q[0] = w - x * hx - y * hy - z * hz;
+        q[1] = x + w * hx + y * hz - z * hy;
+        q[2] = y + w * hy - x * hz + z * hx;
+        q[3] = z + w * hz + x * hy - y * hx;
+        float inv = 1.0f / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int i = 0; i < 4; i++) q[i] *= inv;
+
+        publish_angles();
+        return attitude_;
+    }
+
+    // Shortest rotation taking the measured gravity to earth +Z, yaw 0
+    void AttitudeEstimator::align(float ax, float ay, float az) {
+        float roll = std::atan2(ay, az);
+        float pitch = std::atan2(-ax, std::sqrt(ay * ay + az * az));
+        float cr = std::cos(roll / 2), sr = std::sin(roll / 2), cp = std::cos(pitch / 2), sp = std::sin(pitch / 2);
+        float *q = attitude_.q;
+        q[0] = cr * cp;
+        q[1] = sr * cp;
+        q[2] = cr * sp;
+        q[3] = -sr * sp;
+        bias_[0] = bias_[1] = bias_[2] = 0;
+        started_ = true;
+    }
+
+    void AttitudeEstimator::publish_angles() {
+        const float *q = attitude_.q;
+        attitude_.roll = std::atan2(2 * (q[0] * q[1] + q[2] * q[3]), 1 - 2 * (q[1] * q[1] + q[2] * q[2])) * DEG_PER_RAD;
+        attitude_.pitch = std::asin(std::clamp(2 * (q[0] * q[2] - q[3] * q[1]), -1.0f, 1.0f)) * DEG_PER_RAD;
+
+        // Earth up in the sensor frame against the body axis
+        float vx = 2 * (q[1] * q[3] - q[0] * q[2]);
+        float vy = 2 * (q[0] * q[1] + q[2] * q[3]);
+        float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+        float cos_tilt = std::clamp(vx * body_[0] + vy * body_[1] + vz * body_[2], -1.0f, 1.0f);
+        float tilt = std::acos(cos_tilt) * DEG_PER_RAD;
+        attitude_.tilt = tilt;
+
+        // Boundaries move away from the current posture by the hysteresis
+        float h = POSTURE_HYSTERESIS_DEG;
+        Posture posture = attitude_.posture;
+        float sitting = posture == Posture::UPRIGHT ? SITTING_DEG + h : SITTING_DEG - h;
+        float lying = posture == Posture::LYING ? LYING_DEG - h : LYING_DEG + h;
+        attitude_.posture = tilt >= lying ? Posture::LYING : tilt >= sitting ? Posture::SITTING : Posture::UPRIGHT;
+    }
+
+    void AttitudeEstimator::set_body_axis(const float axis[3]) {
+        float norm = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        if (norm <= 0) return;
+        for (int i = 0; i < 3; i++) body_[i] = axis[i] / norm;
+    }
+
+    void AttitudeEstimator::reset() {
+        float body[3] = {body_[0], body_[1], body_[2]};
+        *this = AttitudeEstimator();
+        set_body_axis(body);
+    }
+
+} // namespace devices
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include "imu_range.h"
+
+namespace devices {
+    enum class Posture : uint8_t {
+        UPRIGHT = 0,
+        SITTING,            // Reclined
+        LYING
+    };
+
+    struct Attitude {
+        int64_t time_us;            // Sample time, 0 before the first sample
+        float q[4];                 // w, x, y, z: sensor frame to earth frame, yaw drifts (no magnetometer)
+        float roll;                 // deg
+        float pitch;                // deg
+        float tilt;                 // deg between the body axis and vertical
+        Posture posture;
+    };
+
+    // Mahony complementary filter in single precision (the ESP32 has a hardware FPU, Q formats buy nothing here).
+    // The gyro rate is integrated into the quaternion; the accelerometer's gravity direction pulls it back with a
+    // proportional-integral correction, the integral tracking gyro bias. Samples far from 1 g are accelerations,
+    // not gravity, and skip the correction. Constant memory, ~100 multiplies per sample, rate set by the sample times.
+    // Posture is the tilt of the body axis (sensor +Z unless set_body_axis() was called) with hysteresis.
+    class AttitudeEstimator {
+    public:
+
+        static constexpr float KP = 1.0f;                       // Correction gain, ~1 s time constant
+        static constexpr float KI = 0.1f;                       // Gyro bias gain, ~10 s
+        static constexpr float MAX_BIAS_DPS = 10.0f;
+        static constexpr float GRAVITY_GATE_G = 0.15f;          // Accel magnitude tolerance for the correction
+        static constexpr int64_t MAX_STEP_US = 50000;           // Longer gaps restart from the accelerometer
+
+        static constexpr float SITTING_DEG = 35.0f;             // Tilt where UPRIGHT ends
+        static constexpr float LYING_DEG = 65.0f;               // Tilt where SITTING ends
+        static constexpr float POSTURE_HYSTERESIS_DEG = 5.0f;
+
+        // One accel / gyro sample in raw LSB, returns the updated attitude
+        const Attitude &update(int64_t time_us, const int16_t accel[3], const int16_t gyro[3]);
+        const Attitude &attitude() const { return attitude_; }
+        // Unit vector in the sensor frame that points up when the wearer stands, e.g. the gravity reading at rest
+        void set_body_axis(const float axis[3]);
+        void reset();
+
+    private:
+        void align(float ax, float ay, float az);
+        void publish_angles();
+
+        Attitude attitude_ = {0, {1, 0, 0, 0}, 0, 0, 0, Posture::UPRIGHT};
+        float bias_[3] = {};                // rad/s, integral term
+        float body_[3] = {0, 0, 1};
+        bool started_ = false;
+
+    }; // class AttitudeEstimator
+
+} // namespace devices
@@ -0,0 +1,88 @@
+#include "fall_detector.h"
+#include <cmath>
+
+namespace devices {
+    bool FallDetector::push(int64_t time_us, const int16_t accel[3], const int16_t gyro[3]) {
+        float ax = accel[0] / ACCEL_LSB_PER_G, ay = accel[1] / ACCEL_LSB_PER_G, az = accel[2] / ACCEL_LSB_PER_G;
+        float magnitude = std::sqrt(ax * ax + ay * ay + az * az);
+        int64_t elapsed = time_us - stage_us_;
+
+        switch (stage_) {
+        case Stage::IDLE:
+            upright_[0] += (ax - upright_[0]) * UPRIGHT_ALPHA;
+            upright_[1] += (ay - upright_[1]) * UPRIGHT_ALPHA;
+            upright_[2] += (az - upright_[2]) * UPRIGHT_ALPHA;
+            if (magnitude < FREE_FALL_G) {
+                stage_ = Stage::FREE_FALL;
+                stage_us_ = time_us;
+            }
+            return false;
+
+        case Stage::FREE_FALL:
+            if (magnitude < FREE_FALL_G) return false;
+            if (elapsed < MIN_FREE_FALL_US) {
+                stage_ = Stage::IDLE;
+                return false;
+            }
+            free_fall_us_ = elapsed;
+            stage_ = Stage::AWAIT_IMPACT;
+            stage_us_ = time_us;
+            elapsed = 0;
+            [[fallthrough]];        // The impact often lands on the sample that ends the free fall
+
+        case Stage::AWAIT_IMPACT:
+            if (magnitude >= IMPACT_G) {
+                event_.impact_us = time_us;
+                event_.impact_g = magnitude;
+                event_.free_fall_ms = static_cast<uint16_t>(free_fall_us_ / 1000);
+                stage_ = Stage::IMPACT;
+                stage_us_ = time_us;
+            }
+            else if (elapsed > IMPACT_WINDOW_US) stage_ = Stage::IDLE;
+            return false;
+
+        case Stage::IMPACT:
+            if (magnitude > event_.impact_g) {
+                event_.impact_g = magnitude;
+                event_.impact_us = time_us;
+            }
+            if (time_us - event_.impact_us >= SETTLE_US) start_inactivity(time_us);
+            return false;
+
+        case Stage::INACTIVITY: {
+            float gx = gyro[0] / GYRO_LSB_PER_DPS, gy = gyro[1] / GYRO_LSB_PER_DPS, gz = gyro[2] / GYRO_LSB_PER_DPS;
+            float rate = std::sqrt(gx * gx + gy * gy + gz * gz);
+            if (std::fabs(magnitude - 1.0f) > REST_DEVIATION_G || rate > REST_DPS) {
+                if (time_us - event_.impact_us < MAX_SETTLE_US) start_inactivity(time_us);
+                else stage_ = Stage::IDLE;
+                return false;
+            }
+            rest_[0] += ax;
+            rest_[1] += ay;
+            rest_[2] += az;
+            if (elapsed < INACTIVITY_US) return false;
+
+            stage_ = Stage::IDLE;
+            float dot = rest_[0] * upright_[0] + rest_[1] * upright_[1] + rest_[2] * upright_[2];
+            float norms = std::sqrt((rest_[0] * rest_[0] + rest_[1] * rest_[1] + rest_[2] * rest_[2]) *
+                                    (upright_[0] * upright_[0] + upright_[1] * upright_[1] + upright_[2] * upright_[2]));
+            if (norms <= 0 || dot > norms * std::cos(MIN_TILT_DEG * static_cast<float>(M_PI) / 180.0f)) return false;
+
+            event_.detected_us = time_us;
+            return true;
+        }
+        }
+        return false;
+    }
+
+    void FallDetector::start_inactivity(int64_t time_us) {
+        stage_ = Stage::INACTIVITY;
+        stage_us_ = time_us;
+        rest_[0] = rest_[1] = rest_[2] = 0;
+    }
+
+    void FallDetector::reset() {
+        *this = FallDetector();
+    }
+
+} // namespace devices
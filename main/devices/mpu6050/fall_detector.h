@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include "imu_range.h"
+
+namespace devices {
+    struct FallEvent {
+        int64_t impact_us;          // Sample time of the impact peak
+        int64_t detected_us;        // Sample time inactivity was confirmed
+        float impact_g;             // Peak acceleration magnitude
+        uint16_t free_fall_ms;
+    };
+
+    // Three-stage fall detector on the accel / gyro stream: free fall (magnitude well below 1 g), an impact
+    // shortly after it, then inactivity in a posture tilted away from the one held before the free fall.
+    // Movement after the impact restarts the inactivity window while the wearer is still tumbling; movement
+    // past MAX_SETTLE_US means they got up or kept going, and a still but upright wearer landed a jump.
+    // Stages close on sample time; detection lags the impact by SETTLE_US + INACTIVITY_US to MAX_SETTLE_US + INACTIVITY_US.
+    class FallDetector {
+    public:
+
+        static constexpr float FREE_FALL_G = 0.5f;
+        static constexpr int64_t MIN_FREE_FALL_US = 80000;      // ~3 cm of drop, shorter dips are arm swings
+        static constexpr int64_t IMPACT_WINDOW_US = 500000;     // After the free fall ends
+        static constexpr float IMPACT_G = 2.5f;
+        static constexpr int64_t SETTLE_US = 200000;            // Rebound after the impact
+        static constexpr int64_t MAX_SETTLE_US = 1000000;       // Latest start of the inactivity window
+        static constexpr int64_t INACTIVITY_US = 700000;
+        static constexpr float REST_DEVIATION_G = 0.25f;        // Of the magnitude from 1 g
+        static constexpr float REST_DPS = 60.0f;
+        static constexpr float MIN_TILT_DEG = 35.0f;            // Rest posture against the upright reference
+        static constexpr float UPRIGHT_ALPHA = 0.02f;           // Per sample, ~0.5 s at 100 Hz
+
+        // True when the sample confirmed a fall, event() then holds it
+        bool push(int64_t time_us, const int16_t accel[3], const int16_t gyro[3]);
+        const FallEvent &event() const { return event_; }
+        void reset();
+
+    private:
+        void start_inactivity(int64_t time_us);
+
+        enum class Stage {
+            IDLE = 0,
+            FREE_FALL,
+            AWAIT_IMPACT,
+            IMPACT,             // Tracking the peak and settling
+            INACTIVITY
+        };
+
+        Stage stage_ = Stage::IDLE;
+        int64_t stage_us_ = 0;              // Start of the current stage
+        int64_t free_fall_us_ = 0;
+        FallEvent event_ = {};
+        float upright_[3] = {0, 0, 1};      // Smoothed accel while IDLE, frozen through a fall
+        float rest_[3] = {};                // Accel sum over the inactivity window
+
+    }; // class FallDetector
+
+} // namespace devices
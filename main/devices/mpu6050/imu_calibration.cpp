@@ -0,0 +1,82 @@
+#include "imu_calibration.h"
+#include <algorithm>
+#include <cmath>
+
+namespace devices {
+    ImuCalibrator::ImuCalibrator() : calibration_{VERSION, {0, 0, 0}, 1.0f} {}
+
+    bool ImuCalibrator::load(const ImuCalibration &calibration) {
+        const float offset[3] = {
+            static_cast<float>(calibration.gyro_offset[0]),
+            static_cast<float>(calibration.gyro_offset[1]),
+            static_cast<float>(calibration.gyro_offset[2])
+        };
+        if (calibration.version != VERSION || !valid(offset, calibration.accel_scale)) return false;
+
+        calibration_ = calibration;
+        needed_ = false;
+        drift_windows_ = 0;
+        return true;
+    }
+
+    bool ImuCalibrator::push(const int16_t accel[3], const int16_t gyro[3]) {
+        count_++;
+        for (int i = 0; i < 6; i++) {
+            float value = i < 3 ? accel[i] : gyro[i - 3];
+            float delta = value - mean_[i];
+            mean_[i] += delta / count_;
+            m2_[i] += delta * (value - mean_[i]);
+        }
+        if (count_ < WINDOW_SAMPLES) return false;
+
+        bool changed = end_window();
+        count_ = 0;
+        std::fill(mean_, mean_ + 6, 0.0f);
+        std::fill(m2_, m2_ + 6, 0.0f);
+        return changed;
+    }
+
+    bool ImuCalibrator::end_window() {
+        for (int i = 0; i < 6; i++) {
+            float sd = std::sqrt(m2_[i] / (count_ - 1));
+            if (sd > (i < 3 ? MAX_ACCEL_SD_G * ACCEL_LSB_PER_G : MAX_GYRO_SD_DPS * GYRO_LSB_PER_DPS)) return false;
+        }
+        float magnitude = std::sqrt(mean_[0] * mean_[0] + mean_[1] * mean_[1] + mean_[2] * mean_[2]);
+        if (magnitude <= 0) return false;
+
+        float scale = ACCEL_LSB_PER_G / magnitude;
+        const float *bias = mean_ + 3;
+        if (!valid(bias, scale)) return false;
+
+        if (!needed_) {
+            bool drift = std::fabs(scale / calibration_.accel_scale - 1) > DRIFT_SCALE;
+            for (int i = 0; i < 3; i++) {
+                drift = drift || std::fabs(bias[i] - calibration_.gyro_offset[i]) > DRIFT_DPS * GYRO_LSB_PER_DPS;
+            }
+            drift_windows_ = drift ? drift_windows_ + 1 : 0;
+            if (drift_windows_ < DRIFT_WINDOWS) return false;
+        }
+
+        for (int i = 0; i < 3; i++) calibration_.gyro_offset[i] = static_cast<int16_t>(std::lround(bias[i]));
+        calibration_.accel_scale = scale;
+        needed_ = false;
+        drift_windows_ = 0;
+        return true;
+    }
+
+    bool ImuCalibrator::valid(const float gyro_offset[3], float accel_scale) const {
+        for (int i = 0; i < 3; i++) {
+            if (std::fabs(gyro_offset[i]) > MAX_GYRO_BIAS_DPS * GYRO_LSB_PER_DPS) return false;
+        }
+        return std::fabs(accel_scale - 1) <= MAX_SCALE_ERROR;
+    }
+
+    void ImuCalibrator::apply(int16_t accel[3], int16_t gyro[3]) const {
+        for (int i = 0; i < 3; i++) {
+            float a = std::clamp(accel[i] * calibration_.accel_scale, -32768.0f, 32767.0f);
+            accel[i] = static_cast<int16_t>(std::lround(a));
+            gyro[i] = static_cast<int16_t>(std::clamp<int32_t>(gyro[i] - calibration_.gyro_offset[i], -32768, 32767));
+        }
+    }
+
+} // namespace devices
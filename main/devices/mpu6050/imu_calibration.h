@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include "imu_range.h"
+
+namespace devices {
+    // Stored as an NVS blob, a different version or size is ignored
+    struct ImuCalibration {
+        uint32_t version;
+        int16_t gyro_offset[3];     // Raw LSB, subtracted
+        float accel_scale;          // Applied to the raw accel, 1 g at rest after it
+    };
+
+    // Gyro bias and accelerometer sensitivity from stationary stretches of the normal sample stream.
+    // Samples collect in windows of WINDOW_SAMPLES; a window is stationary when no axis varies beyond the noise
+    // floor and the magnitude is near 1 g. A single pose cannot separate per-axis accel offsets from tilt,
+    // so the accelerometer only gets a scale. The first stationary window sets the calibration when none is
+    // loaded or one was requested; afterwards a change beyond the drift limits in DRIFT_WINDOWS stationary
+    // windows in a row replaces it.
+    class ImuCalibrator {
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        static constexpr uint16_t WINDOW_SAMPLES = 64;          // 0.64 s at 100 Hz
+        static constexpr float MAX_ACCEL_SD_G = 0.02f;
+        static constexpr float MAX_GYRO_SD_DPS = 1.5f;
+        static constexpr float MAX_GYRO_BIAS_DPS = 20.0f;       // Larger means turning, not bias
+        static constexpr float MAX_SCALE_ERROR = 0.15f;
+        static constexpr float DRIFT_DPS = 0.5f;
+        static constexpr float DRIFT_SCALE = 0.02f;
+        static constexpr uint8_t DRIFT_WINDOWS = 4;
+
+        ImuCalibrator();
+
+        bool load(const ImuCalibration &calibration);           // False when out of range, nothing changes then
+        void request() { needed_ = true; }
+        bool needed() const { return needed_; }
+        // Raw sample; true when the calibration changed and should be stored
+        bool push(const int16_t accel[3], const int16_t gyro[3]);
+        void apply(int16_t accel[3], int16_t gyro[3]) const;
+        const ImuCalibration &calibration() const { return calibration_; }
+
+    private:
+        bool valid(const float gyro_offset[3], float accel_scale) const;
+        bool end_window();
+
+        ImuCalibration calibration_;
+        bool needed_ = true;
+        uint8_t drift_windows_ = 0;
+
+        uint16_t count_ = 0;
+        float mean_[6] = {};                // Accel then gyro, raw LSB
+        float m2_[6] = {};
+
+    }; // class ImuCalibrator
+
+} // namespace devices
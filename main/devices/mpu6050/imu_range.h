@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace devices {
+    // Full-scale ranges the MPU6050 is configured for and the raw scale that follows from them.
+    // Every module converting raw LSB reads these, so a range change stays in one place.
+    inline constexpr uint8_t ACCEL_FS_SEL = 0x18;           // ACCEL_CONFIG AFS_SEL 3: +-16 g
+    inline constexpr uint8_t GYRO_FS_SEL = 0x18;            // GYRO_CONFIG FS_SEL 3: +-2000 dps
+    inline constexpr float ACCEL_LSB_PER_G = 2048.0f;
+    inline constexpr float GYRO_LSB_PER_DPS = 16.4f;
+
+} // namespace devices
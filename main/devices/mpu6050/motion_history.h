@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace devices {
+    // Recent accelerometer samples on the esp_timer timebase, written by the MPU6050 task and read lock-free
+    // by other sensor tasks. Each slot keeps running sums (wrapping uint32_t), so the mean over any
+    // interval is two slot reads apart. Times are the low 32 bits of the microsecond clock (71 min wrap).
+    class MotionHistory {
+    public:
+        static constexpr size_t DEPTH = 256;            // 2.56 s at 100 Hz, covers a full MAX30102 FIFO batch
+        static constexpr size_t AXES = 3;
+
+        void push(int64_t time_us, const int16_t accel[AXES]) {
+            uint32_t head = head_.load(std::memory_order_relaxed);
+            Slot &slot = slots_[head % DEPTH];
+
+            slot.time.store(static_cast<uint32_t>(time_us), std::memory_order_relaxed);
+            for (size_t i = 0; i < AXES; i++) {
+                sum_[i] += static_cast<uint32_t>(static_cast<int32_t>(accel[i]));
+                slot.sum[i].store(sum_[i], std::memory_order_relaxed);
+            }
+            head_.store(head + 1, std::memory_order_release);
+        }
+
+        // Mean acceleration (raw LSB) of the samples in (from_us, to_us]. An interval with no sample
+        // falls back to the last sample before to_us; false when there is no sample close enough.
+        bool mean(int64_t from_us, int64_t to_us, float out[AXES]) const {
+            uint32_t head = head_.load(std::memory_order_acquire);
+            if (head < 2) return false;
+
+            uint32_t oldest = head > DEPTH ? head - DEPTH + GUARD : 0;
+            uint32_t from = static_cast<uint32_t>(from_us);
+            uint32_t to = static_cast<uint32_t>(to_us);
+
+            uint32_t last = last_at_or_before(to, oldest, head);
+            if (last <= oldest || static_cast<int32_t>(to - time_at(last)) > MAX_GAP_US) return false;
+            uint32_t first = last_at_or_before(from, oldest, last);     // last - 1 when no sample is inside
+
+            uint32_t sums[AXES];
+            for (size_t i = 0; i < AXES; i++) {
+                sums[i] = slots_[last % DEPTH].sum[i].load(std::memory_order_relaxed) -
+                          slots_[first % DEPTH].sum[i].load(std::memory_order_relaxed);
+            }
+
+            // The writer may have lapped the slots while they were read
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (head_.load(std::memory_order_relaxed) - first >= DEPTH) return false;
+
+            float count = static_cast<float>(last - first);
+            for (size_t i = 0; i < AXES; i++) out[i] = static_cast<int32_t>(sums[i]) / count;
+            return true;
+        }
+
+    private:
+        static constexpr uint32_t GUARD = 8;            // Slots kept clear of the writer
+        static constexpr int32_t MAX_GAP_US = 100000;   // Older data does not describe the interval
+
+        struct Slot {
+            std::atomic<uint32_t> time{0};
+            std::atomic<uint32_t> sum[AXES] = {};
+        };
+
+        uint32_t time_at(uint32_t index) const { return slots_[index % DEPTH].time.load(std::memory_order_relaxed); }
+
+        // Newest index in [lo, hi) whose time is <= t, lo when none is
+        uint32_t last_at_or_before(uint32_t t, uint32_t lo, uint32_t hi) const {
+            while (hi - lo > 1) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (static_cast<int32_t>(time_at(mid) - t) <= 0) lo = mid;
+                else hi = mid;
+            }
+            return lo;
+        }
+
+        Slot slots_[DEPTH];
+        std::atomic<uint32_t> head_{0};
+        uint32_t sum_[AXES] = {};           // Writer only
+
+    }; // class MotionHistory
+
+} // namespace devices
@@ -1,18 +1,52 @@
 #include "mpu6050.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <algorithm>
+#include <cmath>
+
+#include "core/event_manager.h"
 
 static const char *TAG = "MPU6050";
 
+using namespace core;
+using namespace peripherals;
+
 namespace devices {
-    bool MPU6050::new_val = false;
+    auto &ev_mpu6050 = EventManager::instance();
+
+    // Every data-ready pulse is stamped, the task only wakes once per batch
+    static void intr_handle(void *arg) {
+        MPU6050 *self = static_cast<MPU6050 *>(arg);
+        uint32_t samples = self->intr_stamp_.record(esp_timer_get_time());
+        if (!self->sensor_task || samples % self->intr_batch_) return;
+
+        BaseType_t hpw = pdFALSE;
+        vTaskNotifyGiveFromISR(self->sensor_task, &hpw);
+        portYIELD_FROM_ISR(hpw);
+    }
 
     MPU6050::MPU6050(peripherals::I2C *i2c_driver, i2c_port_num_t i2c_port_num, uint16_t device_address, uint32_t i2c_freq_hz,
-                    EnableLog show_values_log)
+                    gpio_num_t intr_pin, EnableLog show_values_log, MpuReadMode read_mode)
                         : i2c_driver_(i2c_driver),
                         i2c_port_num_(i2c_port_num),
                         device_address_(device_address),
                         i2c_freq_hz_(i2c_freq_hz),
-                        show_values_log_(show_values_log) {}
+                        intr_pin_(intr_pin),
+                        show_values_log_(show_values_log),
+                        read_mode_(read_mode) {}
+
+    MPU6050::~MPU6050() {
+        if (sensor_task) {
+            vTaskDelete(sensor_task);
+            sensor_task = nullptr;
+        }
+
+        gpio_isr_handler_remove(intr_pin_);
+
+        i2c_driver_->remove_dev(dev_handle_);
+        ESP_LOGI(TAG, "MPU6050 deleted.");
+    }
 
     void MPU6050::init() {
         i2c_driver_->add_dev(i2c_port_num_, &dev_handle_, device_address_, i2c_freq_hz_);
@@ -28,48 +62,243 @@ namespace devices {
                 vTaskDelay(1000 / portTICK_PERIOD_MS);
             }
         }
+
+        load_calibration();
+        ev_mpu6050.subscribe_intr(EventID::IMU_CALIBRATE, [this](int data) { this->request_calibration(); });
+
+        GPIO::input_config(intr_pin_, GPIO_MODE_INPUT, GPIO_PULLUP_DISABLE, GPIO_PULLDOWN_ENABLE, GPIO_INTR_POSEDGE);
+        gpio_install_isr_service(0);        // ESP_ERR_INVALID_STATE when another driver already installed it
+        gpio_isr_handler_add(intr_pin_, intr_handle, this);
     }
 
     void MPU6050::start() {
         init();
 
         xTaskCreatePinnedToCore([](void *arg) { static_cast<MPU6050 *>(arg)->start_task(arg); },
-            "Start MAX30102 task", 1024 * 4, this, 2, &sensor_task, 1
+            "Start MPU6050 task", 1024 * 4, this, 2, &sensor_task, 1
         );
     }
 
     void MPU6050::start_task(void *pvParameters) {
+        if (read_mode_ == MpuReadMode::FIFO) reset_fifo();
+        samples_read_ = intr_stamp_.count();
+        config(INT_ENABLE, DATA_RDY_EN);
+
         while (true) {
-            if (querry(INT_STATUS) & 1) {
-                querry();
+            if (low_power_.load(std::memory_order_relaxed)) {
+                ulTaskNotifyTake(pdTRUE, WOM_POLL_MS / portTICK_PERIOD_MS);
+                if (querry(INT_STATUS) & MOT_INT) exit_low_power();
+                continue;
+            }
+
+            bool notified = ulTaskNotifyTake(pdTRUE, INTR_TIMEOUT_MS / portTICK_PERIOD_MS) == pdTRUE;
+            if (read_mode_ == MpuReadMode::FIFO) drain_fifo();
+            else if (notified || (querry(INT_STATUS) & DATA_RDY_INT)) querry();     // Timeout: pulses missed
+
+            if (calibration_requested_.exchange(false, std::memory_order_relaxed)) {
+                calibrator_.request();
+                ESP_LOGI(TAG, "Calibration requested, keep the sensor still");
             }
+            if (calibration_changed_) save_calibration();
+            if (power_mode_ == MpuPowerMode::WAKE_ON_MOTION && still_since_us_ &&
+                    last_sample_us_ - still_since_us_ >= WOM_IDLE_US) enter_low_power();
+        }
+    }
+
+    // Gyro in standby, the accelerometer wakes at 20 Hz for one sample and raises MOT_INT when the high-passed
+    // change passes the threshold. The INT pin carries the motion pulse instead of data-ready.
+    void MPU6050::enter_low_power() {
+        config(INT_ENABLE, 0x00);
+        config(USER_CTRL, 0x00);        // FIFO off, reset_fifo() restarts it
+        config(ACCEL_CONFIG, ACCEL_FS_SEL | ACCEL_HPF_5HZ);
+        config(MOT_THR, WOM_THRESHOLD_MG / 2);
+        config(MOT_DUR, 1);
+        config(MOT_DETECT_CTRL, ACCEL_ON_DELAY_3MS);
+        vTaskDelay(WOM_HPF_SETTLE_MS / portTICK_PERIOD_MS);
+        config(ACCEL_CONFIG, ACCEL_FS_SEL | ACCEL_HPF_HOLD);
+        config(PWR_MGMT_2, LP_WAKE_20HZ | STBY_GYRO);
+        config(PWR_MGMT_1, PWR_CYCLE | TEMP_DIS);      // Internal oscillator, the gyro PLL is off
+
+        intr_batch_ = 1;
+        low_power_.store(true, std::memory_order_relaxed);
+        querry(INT_STATUS);             // Clears stale flags
+        config(INT_ENABLE, MOT_EN);
+        ESP_LOGI(TAG, "Still for %" PRId64 " s, wake-on-motion", WOM_IDLE_US / 1000000);
+    }
 
-            vTaskDelay(50 / portTICK_PERIOD_MS);
+    void MPU6050::exit_low_power() {
+        config(INT_ENABLE, 0x00);
+        config(PWR_MGMT_1, 0x0B);
+        config(PWR_MGMT_2, 0x00);
+        config(ACCEL_CONFIG, ACCEL_FS_SEL);
+
+        // The first batch after the gap re-anchors the clock, downstream algorithms restart on the time gap
+        intr_batch_ = read_mode_ == MpuReadMode::FIFO ? FIFO_BATCH : 1;
+        clock_.restart(SAMPLE_PERIOD_US);
+        if (read_mode_ == MpuReadMode::FIFO) reset_fifo();
+        samples_read_ = intr_stamp_.count();
+        still_since_us_ = 0;
+        low_power_.store(false, std::memory_order_relaxed);
+        config(INT_ENABLE, DATA_RDY_EN);
+        ESP_LOGI(TAG, "Motion, full-rate acquisition");
+    }
+
+    // Stored offsets apply from the first sample; without them the first stationary window calibrates
+    void MPU6050::load_calibration() {
+        nvs_handle_t handle;
+        ImuCalibration calibration;
+        size_t size = sizeof(calibration);
+
+        bool loaded = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK;
+        if (loaded) {
+            loaded = nvs_get_blob(handle, NVS_CALIBRATION, &calibration, &size) == ESP_OK && size == sizeof(calibration);
+            nvs_close(handle);
+        }
+        if (loaded && calibrator_.load(calibration)) {
+            ESP_LOGI(TAG, "Calibration loaded: gyro offset %d %d %d, accel scale %.4f", calibration.gyro_offset[0],
+                calibration.gyro_offset[1], calibration.gyro_offset[2], calibration.accel_scale);
         }
+        else ESP_LOGW(TAG, "No stored calibration, calibrating on the first stationary window");
+    }
+
+    // Sensor task, between batches: the flash write stalls it for a few ms, the FIFO covers that
+    void MPU6050::save_calibration() {
+        calibration_changed_ = false;
+        const ImuCalibration &calibration = calibrator_.calibration();
+
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+        if (err == ESP_OK) {
+            err = nvs_set_blob(handle, NVS_CALIBRATION, &calibration, sizeof(calibration));
+            if (err == ESP_OK) err = nvs_commit(handle);
+            nvs_close(handle);
+        }
+        if (err != ESP_OK) ESP_LOGE(TAG, "Calibration not stored: %s", esp_err_to_name(err));
+        else ESP_LOGI(TAG, "Calibration stored: gyro offset %d %d %d, accel scale %.4f", calibration.gyro_offset[0],
+            calibration.gyro_offset[1], calibration.gyro_offset[2], calibration.accel_scale);
+    }
+
+    // Latest ISR stamp and the number of pulses up to it
+    int64_t MPU6050::take_intr_time(uint32_t &samples) {
+        return intr_stamp_.read(samples);
     }
 
     uint8_t MPU6050::querry(uint8_t reg) {
-        uint8_t data;
+        uint8_t data = 0;           // Reads as no flags set when the transaction fails
         trans_buf_[0] = reg;
         i2c_driver_->write_read(dev_handle_, trans_buf_, 1, &data, 1);
 
         return data;
     }
 
+    // Accel, temp and gyro registers are contiguous: one transaction for the whole sample
     void MPU6050::querry() {
-        uint8_t data[6];
+        uint8_t data[BURST_BYTES];
         trans_buf_[0] = ACCEL_X_H;
-        trans_buf_[1] = GYRO_X_H;
+        if (i2c_driver_->write_read(dev_handle_, trans_buf_, 1, data, BURST_BYTES) != ESP_OK) return;
+
+        // The registers hold the newest sample, older ones the task was late for are gone
+        uint32_t samples;
+        int64_t intr_us = take_intr_time(samples);
+        if (samples != samples_read_) clock_.batch(intr_us, 1, 0, samples - samples_read_ > 1);
+        else clock_.batch(clock_.synced() ? 0 : esp_timer_get_time(), 1, 0, false);
+        samples_read_ = samples;
+
+        process_sample(data, data + BURST_GYRO, clock_.time(0));
+    }
+
+    void MPU6050::drain_fifo() {
+        uint8_t regs[2];
+        bool overflow = querry(INT_STATUS) & FIFO_OFLOW_INT;
+        trans_buf_[0] = FIFO_COUNT_H;
+        if (i2c_driver_->write_read(dev_handle_, trans_buf_, 1, regs, 2) != ESP_OK) return;
+        uint16_t bytes = (regs[0] << 8) | regs[1];
 
-        i2c_driver_->write_read(dev_handle_, trans_buf_, 1, data, 6);
-        accel_x_ = (data[0] << 8) | data[1];
-        accel_y_ = (data[2] << 8) | data[3];
-        accel_z_ = (data[4] << 8) | data[5];
+        // A full FIFO drops whole records at arbitrary byte offsets, so the stream restarts
+        if (overflow || bytes > FIFO_SIZE - RECORD_BYTES) {
+            reset_fifo();
+            ESP_LOGW(TAG, "FIFO overflow, reset");
+            return;
+        }
+        uint16_t count = bytes / RECORD_BYTES;
+        if (!count) return;
 
-        i2c_driver_->write_read(dev_handle_, &trans_buf_[1], 1, data, 6);
-        gyro_x_ = (data[0] << 8) | data[1];
-        gyro_y_ = (data[2] << 8) | data[3];
-        gyro_z_ = (data[4] << 8) | data[5];
+        // Pulse n marked sample n, so the stamp lands inside this batch unless pulses were missed
+        uint32_t samples;
+        int64_t intr_us = take_intr_time(samples);
+        uint32_t ref = samples - samples_read_ - 1;
+        if (samples != samples_read_ && ref < count) clock_.batch(intr_us, count, ref, fifo_lost_);
+        else if (clock_.synced() && !fifo_lost_) clock_.batch(0, count, 0, false);
+        else clock_.batch(esp_timer_get_time(), count, count - 1, true);
+        fifo_lost_ = false;
+
+        // The next chunk transfers while this one is processed
+        peripherals::I2cRequest *request;
+        uint16_t n = std::min<uint16_t>(count, MAX_READ_SAMPLES);
+        esp_err_t err = read_fifo(fifo_buf_[0], n, &request);
+        for (uint16_t done = 0, chunk = 0; done < count; chunk ^= 1) {
+            if (err == ESP_OK) err = i2c_driver_->wait(request);
+            uint16_t next = std::min<uint16_t>(count - done - n, MAX_READ_SAMPLES);
+            if (err == ESP_OK && next) err = read_fifo(fifo_buf_[chunk ^ 1], next, &request);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "FIFO read failed: %s, reset", esp_err_to_name(err));
+                reset_fifo();
+                return;
+            }
+
+            for (uint16_t i = 0; i < n; i++) {
+                const uint8_t *record = &fifo_buf_[chunk][i * RECORD_BYTES];
+                process_sample(record, record + 6, clock_.time(done + i));
+            }
+            done += n;
+            n = next;
+        }
+        samples_read_ += count;
+    }
+
+    esp_err_t MPU6050::read_fifo(uint8_t *buf, uint16_t samples, peripherals::I2cRequest **request) {
+        static constexpr uint8_t reg = FIFO_R_W;
+        return i2c_driver_->submit(dev_handle_, {.write_buf = &reg, .write_size = 1,
+                                                .read_buf = buf, .read_size = static_cast<size_t>(samples) * RECORD_BYTES}, request);
+    }
+
+    void MPU6050::reset_fifo() {
+        config(USER_CTRL, USER_FIFO_RESET);
+        config(USER_CTRL, USER_FIFO_EN);
+        samples_read_ = intr_stamp_.count();
+        fifo_lost_ = true;
+    }
+
+    void MPU6050::process_sample(const uint8_t *accel, const uint8_t *gyro, int64_t time_us) {
+        int16_t accel_xyz[MotionHistory::AXES], gyro_xyz[3];
+        for (int i = 0; i < 3; i++) {
+            accel_xyz[i] = (accel[2 * i] << 8) | accel[2 * i + 1];
+            gyro_xyz[i] = (gyro[2 * i] << 8) | gyro[2 * i + 1];
+        }
+        if (calibrator_.push(accel_xyz, gyro_xyz)) calibration_changed_ = true;
+        calibrator_.apply(accel_xyz, gyro_xyz);
+
+        // Stillness for the wake-on-motion idle timeout
+        float ax = accel_xyz[0] / ACCEL_LSB_PER_G, ay = accel_xyz[1] / ACCEL_LSB_PER_G, az = accel_xyz[2] / ACCEL_LSB_PER_G;
+        float magnitude = std::sqrt(ax * ax + ay * ay + az * az);
+        constexpr int32_t STILL_RATE = static_cast<int32_t>(STILL_DPS * GYRO_LSB_PER_DPS);
+        bool still = std::fabs(magnitude - 1.0f) < STILL_ACCEL_G && std::abs(gyro_xyz[0]) < STILL_RATE &&
+                     std::abs(gyro_xyz[1]) < STILL_RATE && std::abs(gyro_xyz[2]) < STILL_RATE;
+        if (!still) still_since_us_ = 0;
+        else if (!still_since_us_) still_since_us_ = time_us;
+        last_sample_us_ = time_us;
+
+        accel_x_ = accel_xyz[0];
+        accel_y_ = accel_xyz[1];
+        accel_z_ = accel_xyz[2];
+        gyro_x_ = gyro_xyz[0];
+        gyro_y_ = gyro_xyz[1];
+        gyro_z_ = gyro_xyz[2];
+
+        motion_.push(time_us, accel_xyz);
+        if (activity_monitor_.push(time_us, accel_xyz)) activity_.publish(activity_monitor_.report());
+        if (fall_detector_.push(time_us, accel_xyz, gyro_xyz)) on_fall();
+        attitude_.publish(attitude_estimator_.update(time_us, accel_xyz, gyro_xyz));
 
         // ESP_LOGW(TAG, "%d", accel_x_);
         // ESP_LOGW(TAG, "%d", accel_y_);
@@ -79,8 +308,18 @@ namespace devices {
         // ESP_LOGW(TAG, "%d", gyro_y_);
         // ESP_LOGW(TAG, "%d", gyro_z_);
         // ESP_LOGE(TAG, "-----------------------------");
+    }
+
+    // Sensor task, straight from the detecting sample: the MQTT alert is only a queue send, the buzzer runs off the event
+    void MPU6050::on_fall() {
+        const FallEvent &fall = fall_detector_.event();
+        int64_t now = esp_timer_get_time();
 
-        new_val = true;
+        bool queued = fall_alert_ && fall_alert_->raise({now, fall.impact_us, fall.impact_g, fall.free_fall_ms});
+        ev_mpu6050.publish_priority(EventID::FALL, static_cast<int>(std::lround(fall.impact_g * 1000)));
+        ESP_LOGW(TAG, "Fall: %u ms free fall, %.1f g impact, detected %" PRId64 " ms after it (%" PRId64 " us behind the sample)%s",
+            fall.free_fall_ms, fall.impact_g, (fall.detected_us - fall.impact_us) / 1000, now - fall.detected_us,
+            queued ? "" : ", MQTT alert NOT queued");
     }
 
     void MPU6050::config(uint8_t reg, uint8_t option) {
@@ -93,10 +332,15 @@ namespace devices {
         config(PWR_MGMT_1, RESET);
         config(PWR_MGMT_1, 0x08);
         config(PWR_MGMT_1, 0x0B);
-        config(CONFIG, 0x06);
-        config(SMPRT_DIV, 0xC7);
-        config(GYRO_CONFIG, 0x18);
-        config(ACCEL_CONFIG, 0x18);
+        config(CONFIG, 0x03);           // DLPF 44 Hz, gyro output rate 1 kHz
+        config(SMPRT_DIV, 0x09);        // 100 Hz, reference for the MAX30102 motion canceller
+        config(GYRO_CONFIG, GYRO_FS_SEL);
+        config(ACCEL_CONFIG, ACCEL_FS_SEL);
+        config(INT_PIN_CFG, 0x00);      // Active high push-pull, 50 us pulse per data-ready
+        config(INT_ENABLE, 0x00);       // Enabled once the task runs
+        config(FIFO_EN, read_mode_ == MpuReadMode::FIFO ? FIFO_ACCEL_GYRO : 0x00);
+        intr_batch_ = read_mode_ == MpuReadMode::FIFO ? FIFO_BATCH : 1;
+        clock_.restart(SAMPLE_PERIOD_US);
 
         // ESP_LOGW(TAG, "0x%02X", querry(GYRO_CONFIG));
         // ESP_LOGW(TAG, "0x%02X", querry(ACCEL_CONFIG));
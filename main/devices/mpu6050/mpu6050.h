@@ -1,17 +1,40 @@
 #pragma once
 
+#include <atomic>
 #include "peripherals/gpio.h"
 #include "peripherals/i2c.h"
 #include "common/config.h"
+#include "common/sample_clock.h"
+#include "common/intr_stamp.h"
+#include "core/result_channel.h"
+#include "imu_range.h"
+#include "motion_history.h"
+#include "activity.h"
+#include "fall_detector.h"
+#include "attitude.h"
+#include "imu_calibration.h"
+#include "protocols/mqtt/fall_alert.h"
 
 namespace devices {
+    enum class MpuReadMode {
+        BURST = 0,          // One interrupt and one 14-byte read (accel, temp, gyro: 0x3B - 0x48) per sample
+        FIFO                // Hardware FIFO drained every FIFO_BATCH samples
+    };
+
+    enum class MpuPowerMode {
+        CONTINUOUS = 0,     // Accel and gyro at the full rate all the time
+        WAKE_ON_MOTION      // Accel-only low-power cycle with the motion interrupt while still, full rate on motion
+    };
+
     class MPU6050 {
     public:
         TaskHandle_t sensor_task = nullptr;
+        common::IntrStamp intr_stamp_;              // Last data-ready pulse and the pulse count, written by the ISR
+        uint32_t intr_batch_ = 1;                   // Pulses per task wake-up
 
         MPU6050(peripherals::I2C *i2c_driver, i2c_port_num_t i2c_port_num, uint16_t device_address, uint32_t i2c_freq_hz,
-                EnableLog show_values_log);
-        // ~MPU6050();
+                gpio_num_t intr_pin, EnableLog show_values_log, MpuReadMode read_mode = MpuReadMode::FIFO);
+        ~MPU6050();
 
         void init();
         void start();
@@ -19,6 +42,11 @@ namespace devices {
         void start_task(void *pvParameters);
         uint8_t querry(uint8_t reg);
         void querry();
+        void drain_fifo();
+        esp_err_t read_fifo(uint8_t *buf, uint16_t samples, peripherals::I2cRequest **request);
+        void process_sample(const uint8_t *accel, const uint8_t *gyro, int64_t time_us);
+        void reset_fifo();
+        int64_t take_intr_time(uint32_t &samples);
         void config(uint8_t reg, uint8_t option);
         void config();
         int16_t get_accel_x() { return accel_x_; }
@@ -27,16 +55,40 @@ namespace devices {
         int16_t get_gyro_x() { return gyro_x_; }
         int16_t get_gyro_y() { return gyro_y_; }
         int16_t get_gyro_z() { return gyro_z_; }
-
-        bool is_new_val() {
-            if (new_val) {
-                new_val = false;
-                return true;
-            }
-            return false;
-        }
+        const MotionHistory &motion() const { return motion_; }
+        core::ResultChannel<ActivityReport> &activity() { return activity_; }      // One report per minute
+        core::ResultChannel<Attitude> &attitude() { return attitude_; }            // Every sample
+        void set_body_axis(const float axis[3]) { attitude_estimator_.set_body_axis(axis); }    // Before start()
+        void request_calibration() { calibration_requested_.store(true, std::memory_order_relaxed); }     // Any task
+        void load_calibration();
+        void set_power_mode(MpuPowerMode mode) { power_mode_ = mode; }     // Before start()
+        bool is_low_power() const { return low_power_.load(std::memory_order_relaxed); }
+        void enter_low_power();
+        void exit_low_power();
+        void save_calibration();
+        void set_fall_alert(protocols::FallAlert *fall_alert) { fall_alert_ = fall_alert; }    // Before start()
+        void on_fall();
 
     private:
+        static constexpr int64_t SAMPLE_PERIOD_US = 10000;  // 1 kHz / (1 + SMPRT_DIV)
+        static constexpr uint32_t FIFO_BATCH = 10;          // Samples per FIFO drain, 10 wake-ups/s at 100 Hz
+        static constexpr uint8_t BURST_BYTES = 14;          // Accel, temp (disabled in PWR_MGMT_1), gyro
+        static constexpr uint8_t BURST_GYRO = 8;            // Gyro offset in the burst
+        static constexpr uint8_t RECORD_BYTES = 12;         // FIFO record: accel, gyro
+        static constexpr uint16_t FIFO_SIZE = 1024;
+        static constexpr uint8_t MAX_READ_SAMPLES = 16;     // Per FIFO read transaction, I2C::MAX_READ bytes
+        static constexpr uint32_t INTR_TIMEOUT_MS = 500;    // No interrupt this long: read anyway
+
+        // Wake on motion: ~70 uA accel-only at 20 Hz against ~3.9 mA with the gyro running
+        static constexpr int64_t WOM_IDLE_US = 30000000;    // Still this long: low-power cycle
+        static constexpr float STILL_ACCEL_G = 0.08f;       // Magnitude from 1 g
+        static constexpr float STILL_DPS = 5.0f;
+        static constexpr uint8_t WOM_THRESHOLD_MG = 40;     // High-passed accel change that wakes
+        static constexpr uint32_t WOM_POLL_MS = 5000;       // Status check in case a pulse was missed
+        static constexpr uint32_t WOM_HPF_SETTLE_MS = 20;   // Before the high-pass reference is held
+        static constexpr const char *NVS_NAMESPACE = "mpu6050";
+        static constexpr const char *NVS_CALIBRATION = "calibration";
+
         static constexpr uint8_t WHO_AM_I = 0x75;
 
     // Sample Rate Divider
@@ -45,6 +97,19 @@ namespace devices {
     // Power Management 1
         static constexpr uint8_t PWR_MGMT_1 = 0x6B;         // Power Management 1 register
         static constexpr uint8_t RESET = 0x80;
+        static constexpr uint8_t PWR_CYCLE = 0x20;          // Sleep / single accel sample at LP_WAKE_CTRL rate
+        static constexpr uint8_t TEMP_DIS = 0x08;
+
+    // Power Management 2
+        static constexpr uint8_t PWR_MGMT_2 = 0x6C;         // Power Management 2 register
+        static constexpr uint8_t LP_WAKE_20HZ = 0x80;       // LP_WAKE_CTRL = 2
+        static constexpr uint8_t STBY_GYRO = 0x07;          // STBY_XG / YG / ZG
+
+    // Motion detection
+        static constexpr uint8_t MOT_THR = 0x1F;            // Motion Detection Threshold register, 2 mg/LSB
+        static constexpr uint8_t MOT_DUR = 0x20;            // Motion Detection Duration register, 1 ms/LSB
+        static constexpr uint8_t MOT_DETECT_CTRL = 0x69;    // Motion Detection Control register
+        static constexpr uint8_t ACCEL_ON_DELAY_3MS = 0x30;
 
     // Configuration
         static constexpr uint8_t CONFIG = 0x1A;             // Configuration register
@@ -52,11 +117,31 @@ namespace devices {
     // Gyroscope Configuration
         static constexpr uint8_t GYRO_CONFIG = 0x1B;        // Gyroscope Configuration register
 
+    // Interrupt configuration
+        static constexpr uint8_t INT_PIN_CFG = 0x37;        // INT Pin / Bypass Enable Configuration register
+        static constexpr uint8_t INT_ENABLE = 0x38;         // Interrupt Enable register
+        static constexpr uint8_t DATA_RDY_EN = 0x01;
+        static constexpr uint8_t MOT_EN = 0x40;
+
     // Interrupt Status
         static constexpr uint8_t INT_STATUS = 0x3A;         // Interrupt Status register
+        static constexpr uint8_t DATA_RDY_INT = 0x01;
+        static constexpr uint8_t FIFO_OFLOW_INT = 0x10;
+        static constexpr uint8_t MOT_INT = 0x40;
+
+    // FIFO
+        static constexpr uint8_t FIFO_EN = 0x23;            // FIFO Enable register
+        static constexpr uint8_t FIFO_ACCEL_GYRO = 0x78;    // Gyro X / Y / Z, accel
+        static constexpr uint8_t USER_CTRL = 0x6A;          // User Control register
+        static constexpr uint8_t USER_FIFO_EN = 0x40;
+        static constexpr uint8_t USER_FIFO_RESET = 0x04;
+        static constexpr uint8_t FIFO_COUNT_H = 0x72;       // FIFO Count H-bits register, L-bits follow
+        static constexpr uint8_t FIFO_R_W = 0x74;           // FIFO Read Write register
 
     // Accelerometer Configuration
         static constexpr uint8_t ACCEL_CONFIG = 0x1C;       // Accelerometer Configuration register
+        static constexpr uint8_t ACCEL_HPF_5HZ = 0x01;      // Digital high-pass for the motion detector
+        static constexpr uint8_t ACCEL_HPF_HOLD = 0x07;     // Motion measured against the last sample before the hold
 
     // Accelerometer Measurements
         static constexpr uint8_t ACCEL_X_H = 0x3B;          // Accelerometer Measurements X H-bits register
@@ -79,10 +164,15 @@ namespace devices {
         i2c_port_num_t i2c_port_num_;
         uint16_t device_address_;
         uint32_t i2c_freq_hz_;
+        gpio_num_t intr_pin_;
         EnableLog show_values_log_;
+        MpuReadMode read_mode_;
 
         uint8_t trans_buf_[2];
-        uint8_t recv_buf_;
+        uint8_t fifo_buf_[2][MAX_READ_SAMPLES * RECORD_BYTES];     // One read in flight while the other is processed
+        common::SampleClock clock_;
+        uint32_t samples_read_ = 0;         // Samples taken, in step with the intr_stamp_ count
+        bool fifo_lost_ = false;            // FIFO reset after an overflow, the next batch re-anchors the clock
 
         int16_t accel_x_;
         int16_t accel_y_;
@@ -90,7 +180,21 @@ namespace devices {
         int16_t gyro_x_;
         int16_t gyro_y_;
         int16_t gyro_z_;
-        static bool new_val;
+        MotionHistory motion_;
+        ActivityMonitor activity_monitor_;
+        core::ResultChannel<ActivityReport> activity_;
+        FallDetector fall_detector_;
+        AttitudeEstimator attitude_estimator_;
+        core::ResultChannel<Attitude> attitude_;
+        ImuCalibrator calibrator_;
+        bool calibration_changed_ = false;              // Sensor task, stored after the current batch
+        std::atomic<bool> calibration_requested_{false};
+
+        MpuPowerMode power_mode_ = MpuPowerMode::CONTINUOUS;
+        std::atomic<bool> low_power_{false};
+        int64_t still_since_us_ = 0;        // Sample time stillness began, 0 while moving
+        int64_t last_sample_us_ = 0;
+        protocols::FallAlert *fall_alert_ = nullptr;
 
     }; // class MPU6050
 
@@ -64,6 +64,9 @@ namespace devices {
         uint8_t close_eyes[15] = {0x00, 0x00, 0x08, 0x08, 0x08, 0x00, 0x00, 0x40, 0x00, 0x00, 0x08, 0x08, 0x08, 0x00, 0x00};
         uint8_t tick = 0;
         uint8_t while_ = 0;
+        uint32_t vitals_seq = 0;
+        Vitals vitals;
+        if (max30102_ && !max30102_->vitals().subscribe()) ESP_LOGE(TAG, "Vitals channel has no reader slot left, updates only on timeout");
 
         while (true) {
             if (smartconfig_level_ == LedLevel::LEVEL_0) {
@@ -124,14 +127,15 @@ namespace devices {
                 snprintf(buffer, 5, "%.2f", h);
                 render_text(0, 7, 84, (uint8_t *)buffer);
 
-                if (MAX30102::is_new_val_1()) {
-                    snprintf(buffer, 16, "%5d", MAX30102::heart_rate_);
+                // Redraw as soon as a new reading lands, otherwise refresh the clock every 750 ms
+                if (max30102_ && max30102_->vitals().wait(vitals, vitals_seq, 750 / portTICK_PERIOD_MS)) {
+                    snprintf(buffer, 16, "%5d", vitals.heart_rate);
                     render_text(0, 2, 36, (uint8_t *)buffer);
-                    snprintf(buffer, 16, "%3.2f", MAX30102::spo2_);
+                    snprintf(buffer, 16, "%3.2f", vitals.spo2);
                     render_text(0, 3, 36, (uint8_t *)buffer);
+                } else if (!max30102_) {
+                    vTaskDelay(750 / portTICK_PERIOD_MS);
                 }
-
-                vTaskDelay(750 / portTICK_PERIOD_MS);
             } else if (smartconfig_level_ == LedLevel::LEVEL_1) {
                 if (setup) {
                     setup = false;
@@ -9,6 +9,8 @@ using namespace peripherals;
 using namespace network;
 
 namespace devices {
+    class MAX30102;
+
     class SH1106 {
     public:
         TaskHandle_t time_clock_task_ = nullptr;
@@ -18,6 +20,7 @@ namespace devices {
 
         void init();
         void start();
+        void set_max30102(MAX30102 *max30102) { max30102_ = max30102; }
 
         void time_clock_task(void *pvParameters);
         void set_cursor(uint8_t page, uint8_t col);
@@ -46,6 +49,7 @@ namespace devices {
         gpio_num_t res_pin_;
         int spi_clock_hz_;
         spi_device_handle_t dev_handle_;
+        MAX30102 *max30102_ = nullptr;
 
         static LedLevel smartconfig_level_;
 
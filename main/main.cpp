@@ -16,6 +16,8 @@
 #include "network/net_manager.h"
 #include "core/ota.h"
 #include "protocols/mqtt/mqtt.h"
+#include "protocols/mqtt/waveform_stream.h"
+#include "protocols/mqtt/fall_alert.h"
 #include "core/event_manager.h"
 
 #include "devices/max30102/max30102.h"
@@ -33,14 +35,18 @@ using namespace devices;
 
 auto gpio_ = std::make_unique<GPIO>();
 auto i2c_ = std::make_unique<I2C>(I2C_BUS_0, SDA_PIN, SCL_PIN);
+// auto i2c_1_ = std::make_unique<I2C>(I2C_BUS_1, SDA_PIN_1, SCL_PIN_1);
 auto spi_ = std::make_unique<SPI>(SPI_HOST_0, SPI_MOSI, SPI_MISO, SPI_CLK);
 auto net_manager_ = std::make_unique<NetManager>();
 auto ota_ = std::make_unique<OTA>();
 auto mqtt_ = std::make_unique<MQTT>(SERVER_ADDRESS, PORT, MQTT_TRANSPORT_OVER_TCP);
+auto waveform_ = std::make_unique<WaveformStream>(mqtt_.get());
+auto fall_alert_ = std::make_unique<FallAlert>(mqtt_.get());
 auto &event_manager_ = EventManager::instance();
 
-auto max30102_ = std::make_unique<MAX30102>(i2c_.get(), I2C_BUS_0, MAX30102_ADDRESS, MAX30102_FREQ_HZ, EnableLog::SHOW_ON);
-auto mpu6050_ = std::make_unique<MPU6050>(i2c_.get(), I2C_BUS_0, MPU6050_ADDRESS, MPU6050_FREQ_HZ, EnableLog::SHOW_ON);
+auto max30102_ = std::make_unique<MAX30102>(i2c_.get(), I2C_BUS_0, MAX30102_ADDRESS, MAX30102_FREQ_HZ, MAX30102_INTR, EnableLog::SHOW_ON);
+// auto max30102_1_ = std::make_unique<MAX30102>(i2c_1_.get(), I2C_BUS_1, MAX30102_ADDRESS, MAX30102_FREQ_HZ, MAX30102_INTR_1, EnableLog::SHOW_ON);
+auto mpu6050_ = std::make_unique<MPU6050>(i2c_.get(), I2C_BUS_0, MPU6050_ADDRESS, MPU6050_FREQ_HZ, MPU6050_INTR, EnableLog::SHOW_ON);
 auto sh1106_ = std::make_unique<SH1106>(spi_.get(), SPI_HOST_0, SH1106_CS, SH1106_DC, SH1106_RES, SH1106_FREQ_HZ);
 
 extern "C" void app_main(void) {
@@ -53,37 +59,77 @@ extern "C" void app_main(void) {
 
     gpio_->start();
     i2c_->start();
+    // i2c_1_->start();
     spi_->start();
     net_manager_->start();
     ota_->start();
     mqtt_->start();
     event_manager_.start();
-
+    waveform_->start();
+    fall_alert_->start();
+
+    mpu6050_->set_fall_alert(fall_alert_.get());
+    mpu6050_->set_power_mode(MPU6050_WAKE_ON_MOTION ? MpuPowerMode::WAKE_ON_MOTION : MpuPowerMode::CONTINUOUS);
+    mpu6050_->start();
+    max30102_->set_motion_source(&mpu6050_->motion());
+    max30102_->set_waveform_stream(waveform_.get());
     max30102_->start();
-    // mpu6050_->start();
-    // vTaskDelay(500 / portTICK_PERIOD_MS);
+    // max30102_1_->start(0);
+    sh1106_->set_max30102(max30102_.get());
     sh1106_->start();
 
     // i2c_->scan_dev_address(I2C_BUS_0);
+    // MAX30102::filter_benchmark();
 
     uint8_t i = 0;
+    uint32_t vitals_seq = 0;
+    Vitals vitals;
+    uint32_t activity_seq = 0;
+    ActivityReport activity;
+    uint32_t attitude_seq = 0;
+    Attitude attitude = {};
+    int64_t hrv_sent_us = 0;
+    if (!max30102_->vitals().subscribe()) ESP_LOGE(TAG, "Vitals channel has no reader slot left, updates only on timeout");
     while (true) {
         json json_puber_1;
-        // json json_puber_2;
+        json json_puber_2;
         json_puber_1[ID] = p_info.id;
+        json_puber_2[ID] = p_info.id;
 
         if (!i) {
             ESP_LOGI(TAG, "[APP] Free memory:           %" PRIu32 " bytes", esp_get_free_heap_size());
             ESP_LOGI(TAG, "[APP] Internal free heap:    %d bytes", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
         }
 
-        if (mqtt_->is_connected_ && max30102_->is_new_val()) {
-            int bpm_val = max30102_->get_heart_rate();
+        // Blocks until the sensor publishes, at most one loop period. Low quality windows stay on the device.
+        if (max30102_->vitals().wait(vitals, vitals_seq, 100 / portTICK_PERIOD_MS) && mqtt_->is_connected_ &&
+                vitals.quality.score >= VITALS_QUALITY_MIN) {
+            int bpm_val = vitals.heart_rate;
             std::ostringstream oss;
-            oss << std::fixed << std::setprecision(2) << max30102_->get_spo2();
+            oss << std::fixed << std::setprecision(2) << vitals.spo2;
 
             json_puber_1[BPM] = std::to_string(bpm_val);
             json_puber_1[SPO2] = oss.str();
+            json_puber_1[QUALITY] = std::to_string(vitals.quality.score);
+
+            // Posture as context for the reading, the attitude itself stays on the device
+            static const char *const POSTURE_NAMES[] = {"upright", "sitting", "lying"};
+            mpu6050_->attitude().read(attitude, attitude_seq);
+            if (attitude.time_us) json_puber_1[POSTURE] = POSTURE_NAMES[static_cast<uint8_t>(attitude.posture)];
+
+            // Each HRV period goes out once, with the first reading after it
+            if (vitals.hrv.end_us != hrv_sent_us && vitals.hrv.intervals >= HrvStats::MIN_INTERVALS) {
+                hrv_sent_us = vitals.hrv.end_us;
+                oss.str("");
+                oss << std::setprecision(1) << vitals.hrv.rmssd;
+                json_puber_1[RMSSD] = oss.str();
+                oss.str("");
+                oss << vitals.hrv.sdnn;
+                json_puber_1[SDNN] = oss.str();
+                oss.str("");
+                oss << vitals.hrv.pnn50;
+                json_puber_1[PNN50] = oss.str();
+            }
 
             std::string mess = json_puber_1.dump();
 
@@ -91,21 +137,19 @@ extern "C" void app_main(void) {
             // ESP_LOGW(TAG, "%s", mess.c_str());
         }
 
-        // if (mqtt_->is_connected_ && mpu6050_->is_new_val()) {
-        //     json_puber_2[ACCEL_X] = std::to_string(mpu6050_->get_accel_x());
-        //     json_puber_2[ACCEL_Y] = std::to_string(mpu6050_->get_accel_y());
-        //     json_puber_2[ACCEL_Z] = std::to_string(mpu6050_->get_accel_z());
-        //     json_puber_2[GYRO_X] = std::to_string(mpu6050_->get_gyro_x());
-        //     json_puber_2[GYRO_Y] = std::to_string(mpu6050_->get_gyro_y());
-        //     json_puber_2[GYRO_Z] = std::to_string(mpu6050_->get_gyro_z());
+        // Per-minute features instead of the raw 6-axis stream
+        if (mpu6050_->activity().read(activity, activity_seq) && mqtt_->is_connected_) {
+            static const char *const ACTIVITY_NAMES[] = {"rest", "walk", "run"};
+            json_puber_2[STEPS] = std::to_string(activity.steps);
+            json_puber_2[TOTAL_STEPS] = std::to_string(activity.total_steps);
+            json_puber_2[ACTIVITY] = ACTIVITY_NAMES[static_cast<uint8_t>(activity.activity)];
 
-        //     std::string mess = json_puber_2.dump();
+            std::string mess = json_puber_2.dump();
 
-        //     mqtt_->publish(mqtt_->client_, TOPIC_CENTER_CONNECT, mess.c_str());
-        //     // ESP_LOGW(TAG, "%s", mess.c_str());
-        // }
+            mqtt_->publish(TOPIC_CENTER_ACTIVITY, mess.c_str());
+            // ESP_LOGW(TAG, "%s", mess.c_str());
+        }
 
         if (i++ > 50) i = 0;
-        vTaskDelay(100 / portTICK_PERIOD_MS);
     }
 }
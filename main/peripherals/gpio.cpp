@@ -2,9 +2,13 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
+#include "esp_log.h"
+
 #include "common/config.h"
 #include "core/event_manager.h"
 
+static const char *TAG = "GPIO";
+
 using namespace core;
 
 namespace peripherals {
@@ -24,6 +28,11 @@ namespace peripherals {
     void GPIO::start() {
         init();
 
+        buzzer_queue_ = xQueueCreate(BUZZER_QUEUE_LENGTH, sizeof(BuzzerRequest));
+        xTaskCreate([](void *arg) { static_cast<GPIO *>(arg)->buzzer_task(); },
+            "Buzzer task", 1024 * 2, this, 4, &buzzer_task_
+        );
+
         xTaskCreate([](void *arg) { static_cast<GPIO *>(arg)->start_task(arg); },
             "Start GPIO task", 1024 * 5, this, 2, NULL
         );
@@ -36,6 +45,7 @@ namespace peripherals {
 
         ev_gpio.subscribe(EventID::LED_SC, [this](void *data) { this->event_smartconfig_led(data); });
         ev_gpio.subscribe_intr(EventID::BUZZER, [this](int data) { this->event_buzzer(data); });
+        ev_gpio.subscribe_intr(EventID::FALL, [this](int data) { this->event_fall(data); });
         vTaskDelete(NULL);
     }
 
@@ -132,15 +142,59 @@ namespace peripherals {
         xTaskCreate(task_smartconfig_led, "Start smartconfig led task", 1024, this, 2, &led_task_);
     }
 
+    // Both patterns play on the buzzer task so the event task stays free for the next subscriber
     void GPIO::event_buzzer(int data) {
-        for (uint8_t i = 0; i < data; i++) {
-            ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 4096));
-            ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0));
-            ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+        if (alarm_active_.load(std::memory_order_relaxed)) return;
+
+        BuzzerRequest request = {Tone::BEEP, static_cast<uint8_t>(data)};
+        if (xQueueSend(buzzer_queue_, &request, 0) != pdTRUE) ESP_LOGW(TAG, "Buzzer queue full, beeps dropped");
+    }
+
+    // Takes the buzzer over: pending beeps are dropped and a running pattern stops at its next step
+    void GPIO::event_fall(int data) {
+        if (alarm_active_.exchange(true, std::memory_order_relaxed)) return;
+
+        BuzzerRequest request = {Tone::FALL_ALARM, FALL_ALARM_BEEPS};
+        xQueueReset(buzzer_queue_);
+        xQueueSendToFront(buzzer_queue_, &request, 0);
+        xTaskNotifyGive(buzzer_task_);
+    }
+
+    void GPIO::buzzer_task() {
+        BuzzerRequest request;
+        while (true) {
+            if (xQueueReceive(buzzer_queue_, &request, portMAX_DELAY) != pdTRUE) continue;
+
+            if (request.tone == Tone::FALL_ALARM) {
+                for (uint8_t i = 0; i < request.beeps; i++) {
+                    buzzer_set(true);
+                    vTaskDelay(FALL_ALARM_ON_MS / portTICK_PERIOD_MS);
+                    buzzer_set(false);
+                    vTaskDelay(FALL_ALARM_OFF_MS / portTICK_PERIOD_MS);
+                }
+                alarm_active_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            ulTaskNotifyTake(pdTRUE, 0);        // A fall that already played
+            for (uint8_t i = 0; i < request.beeps; i++) {
+                buzzer_set(true);
+                bool preempted = buzzer_wait(BEEP_MS);
+                buzzer_set(false);
+                if (preempted || buzzer_wait(BEEP_MS)) break;
+            }
         }
     }
 
+    // Beep pause, cut short by a fall; true when the fall alarm is waiting
+    bool GPIO::buzzer_wait(uint32_t ms) {
+        ulTaskNotifyTake(pdTRUE, ms / portTICK_PERIOD_MS);
+        return alarm_active_.load(std::memory_order_relaxed);
+    }
+
+    void GPIO::buzzer_set(bool on) {
+        ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, on ? 4096 : 0));
+        ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+    }
+
 } // namespace peripherals
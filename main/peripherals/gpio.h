@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "driver/gpio.h"
@@ -18,6 +20,16 @@ namespace peripherals {
         LEVEL_3
     };
 
+    enum class Tone : uint8_t {
+        BEEP = 0,
+        FALL_ALARM
+    };
+
+    struct BuzzerRequest {
+        Tone tone;
+        uint8_t beeps;
+    };
+
     class GPIO {
     public:
         void init();
@@ -34,9 +46,23 @@ namespace peripherals {
 
         void event_smartconfig_led(void *data);
         void event_buzzer(int data);
+        void event_fall(int data);
+        void buzzer_task();
 
     private:
+        static constexpr size_t BUZZER_QUEUE_LENGTH = 4;
+        static constexpr uint32_t BEEP_MS = 100;
+        static constexpr uint8_t FALL_ALARM_BEEPS = 10;
+        static constexpr uint32_t FALL_ALARM_ON_MS = 300;
+        static constexpr uint32_t FALL_ALARM_OFF_MS = 150;
+
+        bool buzzer_wait(uint32_t ms);
+        void buzzer_set(bool on);
+
         TaskHandle_t led_task_ = nullptr;
+        TaskHandle_t buzzer_task_ = nullptr;
+        QueueHandle_t buzzer_queue_ = nullptr;      // Only the buzzer task drives LEDC channel 0
+        std::atomic<bool> alarm_active_{false};     // From the fall event until the alarm pattern ends
 
     }; // class GPIO
 
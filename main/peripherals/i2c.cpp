@@ -1,12 +1,102 @@
 #include "i2c.h"
+#include <algorithm>
+#include <cstring>
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "i2c_queue.h"
 
 static const char *TAG = "I2C";
 
+static_assert(configTASK_NOTIFICATION_ARRAY_ENTRIES > peripherals::I2C::NOTIFY_INDEX,
+            "CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES too small for I2C completions");
+
 namespace peripherals {
+    struct I2cRequest {
+        I2cRequestState state;
+        TickType_t submitted;
+        TickType_t timeout_ticks;
+        esp_err_t result;
+        I2cTransaction trans;
+        TaskHandle_t task;                  // Waiting task, null when nobody waits
+        uint8_t write_data[I2C::MAX_WRITE];
+        uint8_t read_data[I2C::MAX_READ];
+    };
+
     static bool i2c_bus_initialized[2] = {false, false};
     static i2c_master_bus_handle_t bus_handle[2] = {nullptr, nullptr};
 
+    static I2cQueue<I2cRequest, I2C::TRANS_QUEUE_DEPTH, I2C::MAX_DEVICES> requests;
+    static i2c_port_num_t device_port[I2C::MAX_DEVICES];
+    static portMUX_TYPE request_lock = portMUX_INITIALIZER_UNLOCKED;
+    static SemaphoreHandle_t submit_lock = nullptr;     // Keeps the in-flight order equal to the driver's
+
+    // Only settles the request, read data stays in the slot for wait() to copy out
+    static bool on_trans_done(i2c_master_dev_handle_t dev_handle, const i2c_master_event_data_t *event, void *arg) {
+        if (event->event == I2C_EVENT_ALIVE) return false;
+
+        esp_err_t result = event->event == I2C_EVENT_DONE ? ESP_OK :
+                            event->event == I2C_EVENT_NACK ? ESP_ERR_INVALID_RESPONSE : ESP_ERR_TIMEOUT;
+        TaskHandle_t task = nullptr;
+        I2cRequest *callback = nullptr;
+
+        portENTER_CRITICAL_ISR(&request_lock);
+        I2cRequest *request = requests.complete(static_cast<int>(reinterpret_cast<intptr_t>(arg)));
+        if (request) {
+            request->result = result;
+            if (request->state == I2cRequestState::ABANDONED || request->state == I2cRequestState::STALE) {
+                requests.release(request);
+            }
+            else if (request->task) {
+                task = request->task;
+                request->state = I2cRequestState::DONE;
+            }
+            else if (request->trans.on_done) callback = request;
+            else requests.release(request);
+        }
+        portEXIT_CRITICAL_ISR(&request_lock);
+
+        if (callback) {
+            callback->trans.on_done(result, callback->read_data, callback->trans.read_size, callback->trans.arg);
+            portENTER_CRITICAL_ISR(&request_lock);
+            requests.release(callback);
+            portEXIT_CRITICAL_ISR(&request_lock);
+        }
+        BaseType_t hpw = pdFALSE;
+        if (task) vTaskNotifyGiveIndexedFromISR(task, I2C::NOTIFY_INDEX, &hpw);
+        return hpw == pdTRUE;
+    }
+
+    // Under submit_lock: settles the requests of wedged devices and resets their bus, so a hung transaction
+    // fails its submitters after RECLAIM_GRACE_MS. The slots return to the pool only on the driver's completion,
+    // the bus reset is what makes the driver finish them.
+    static void reclaim() {
+        TaskHandle_t tasks[I2C::TRANS_QUEUE_DEPTH];
+        I2cTransaction callbacks[I2C::TRANS_QUEUE_DEPTH];       // Copied, the slot may be freed meanwhile
+        size_t task_count = 0, callback_count = 0;
+        bool reset[2] = {false, false};
+
+        portENTER_CRITICAL(&request_lock);
+        requests.reclaim(xTaskGetTickCount(), pdMS_TO_TICKS(I2C::RECLAIM_GRACE_MS), [&](int device, I2cRequest *request) {
+            reset[device_port[device]] = true;
+            // The waiter is past its timeout, it abandons the request once woken
+            if (request->state == I2cRequestState::PENDING && request->task) {
+                tasks[task_count++] = request->task;
+                return;
+            }
+            if (request->state == I2cRequestState::PENDING && request->trans.on_done) callbacks[callback_count++] = request->trans;
+            request->state = I2cRequestState::STALE;
+        });
+        portEXIT_CRITICAL(&request_lock);
+
+        for (size_t i = 0; i < task_count; i++) xTaskNotifyGiveIndexed(tasks[i], I2C::NOTIFY_INDEX);
+        for (size_t i = 0; i < callback_count; i++) callbacks[i].on_done(ESP_ERR_TIMEOUT, nullptr, 0, callbacks[i].arg);
+        for (uint8_t port = 0; port < 2; port++) {
+            if (!reset[port]) continue;
+            ESP_LOGW(TAG, "I2C port num %d wedged, requests reclaimed, resetting the bus", port);
+            i2c_master_bus_reset(bus_handle[port]);
+        }
+    }
+
     I2C::I2C(i2c_port_num_t i2c_port_num, gpio_num_t sda_pin, gpio_num_t scl_pin)
             : i2c_port_num_(i2c_port_num),
             sda_pin_(sda_pin),
@@ -24,6 +114,8 @@ namespace peripherals {
     }
 
     void I2C::init() {
+        if (!submit_lock) submit_lock = xSemaphoreCreateMutex();
+
         if (!i2c_bus_initialized[i2c_port_num_]) {
             i2c_master_bus_config_t bus_config = {
                 .i2c_port = i2c_port_num_,
@@ -31,6 +123,7 @@ namespace peripherals {
                 .scl_io_num = scl_pin_,
                 .clk_source = I2C_CLK_SRC_DEFAULT,
                 .glitch_ignore_cnt = 7,
+                .trans_queue_depth = TRANS_QUEUE_DEPTH,     // Async mode
                 .flags = {
                     .enable_internal_pullup = true,
                 },
@@ -73,23 +166,126 @@ namespace peripherals {
                 .scl_speed_hz = i2c_freq_hz,
             };
             ESP_ERROR_CHECK(i2c_master_bus_add_device(bus_handle[i2c_port_num], &dev_config, dev_handle));
+
+            portENTER_CRITICAL(&request_lock);
+            int device = requests.add_device(*dev_handle);
+            portEXIT_CRITICAL(&request_lock);
+            if (device < 0) {
+                ESP_LOGE(TAG, "No room for device 0x%02X, MAX_DEVICES %d", device_address, MAX_DEVICES);
+                return;
+            }
+            device_port[device] = i2c_port_num;
+
+            i2c_master_event_callbacks_t callbacks = {
+                .on_trans_done = on_trans_done,
+            };
+            ESP_ERROR_CHECK(i2c_master_register_event_callbacks(*dev_handle, &callbacks, reinterpret_cast<void *>(static_cast<intptr_t>(device))));
         } else ESP_LOGW(TAG, "I2C port num %d is not initialized", i2c_port_num);
     }
 
     void I2C::remove_dev(i2c_master_dev_handle_t dev_handle) {
+        int device = requests.find(dev_handle);
+        if (device >= 0) {
+            if (i2c_master_bus_wait_all_done(bus_handle[device_port[device]], REMOVE_WAIT_MS) != ESP_OK) {
+                ESP_LOGW(TAG, "Transactions still pending on removal");
+            }
+            portENTER_CRITICAL(&request_lock);
+            requests.remove_device(device);
+            portEXIT_CRITICAL(&request_lock);
+        }
         ESP_ERROR_CHECK(i2c_master_bus_rm_device(dev_handle));
     }
 
-    void I2C::write_bytes(i2c_master_dev_handle_t dev_handle, uint8_t *write_buf, size_t write_size) {
-        i2c_master_transmit(dev_handle, write_buf, write_size, -1);
+    esp_err_t I2C::write_bytes(i2c_master_dev_handle_t dev_handle, const uint8_t *write_buf, size_t write_size) {
+        return transfer(dev_handle, {.write_buf = write_buf, .write_size = write_size});
+    }
+
+    esp_err_t I2C::read_bytes(i2c_master_dev_handle_t dev_handle, uint8_t *read_buf, size_t read_size) {
+        return transfer(dev_handle, {.read_buf = read_buf, .read_size = read_size});
     }
 
-    void I2C::read_bytes(i2c_master_dev_handle_t dev_handle, uint8_t *read_buf, size_t read_size) {
-        i2c_master_receive(dev_handle, read_buf, read_size, -1);
+    esp_err_t I2C::write_read(i2c_master_dev_handle_t dev_handle, const uint8_t *write_buf, size_t write_size, uint8_t *read_buf, size_t read_size) {
+        return transfer(dev_handle, {.write_buf = write_buf, .write_size = write_size, .read_buf = read_buf, .read_size = read_size});
     }
 
-    void I2C::write_read(i2c_master_dev_handle_t dev_handle, uint8_t *write_buf, size_t write_size, uint8_t *read_buf, size_t read_size) {
-        i2c_master_transmit_receive(dev_handle, write_buf, write_size, read_buf, read_size, -1);
+    esp_err_t I2C::transfer(i2c_master_dev_handle_t dev_handle, const I2cTransaction &trans) {
+        I2cRequest *request;
+        esp_err_t err = submit(dev_handle, trans, &request);
+        if (err == ESP_OK) err = wait(request);
+        if (err != ESP_OK) ESP_LOGW(TAG, "Transaction failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    esp_err_t I2C::submit(i2c_master_dev_handle_t dev_handle, const I2cTransaction &trans, I2cRequest **request) {
+        if ((!trans.write_size && !trans.read_size) || trans.write_size > MAX_WRITE || trans.read_size > MAX_READ) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        int device = requests.find(dev_handle);
+        if (device < 0 || !submit_lock) return ESP_ERR_INVALID_STATE;
+
+        // Nobody waits for a request without on_done and handle, it releases itself
+        TaskHandle_t task = !trans.on_done && request ? xTaskGetCurrentTaskHandle() : nullptr;
+        xSemaphoreTake(submit_lock, portMAX_DELAY);
+        reclaim();
+
+        portENTER_CRITICAL(&request_lock);
+        // Whole ticks, at least the timeout
+        I2cRequest *slot = requests.acquire(device, xTaskGetTickCount(), pdMS_TO_TICKS(std::max(trans.timeout_ms, 1)) + 1);
+        if (slot) {
+            slot->trans = trans;
+            slot->task = task;
+        }
+        portEXIT_CRITICAL(&request_lock);
+
+        esp_err_t err = ESP_ERR_NO_MEM;
+        if (slot) {
+            if (trans.write_size) memcpy(slot->write_data, trans.write_buf, trans.write_size);
+
+            if (trans.write_size && trans.read_size) {
+                err = i2c_master_transmit_receive(dev_handle, slot->write_data, trans.write_size,
+                                                    slot->read_data, trans.read_size, trans.timeout_ms);
+            }
+            else if (trans.write_size) err = i2c_master_transmit(dev_handle, slot->write_data, trans.write_size, trans.timeout_ms);
+            else err = i2c_master_receive(dev_handle, slot->read_data, trans.read_size, trans.timeout_ms);
+
+            // Still the newest entry: submits are serialized and completions only take the oldest
+            if (err != ESP_OK) {
+                portENTER_CRITICAL(&request_lock);
+                requests.cancel(device, slot);
+                portEXIT_CRITICAL(&request_lock);
+            }
+        }
+        xSemaphoreGive(submit_lock);
+
+        if (err == ESP_OK && request) *request = slot;
+        return err;
+    }
+
+    esp_err_t I2C::wait(I2cRequest *request) {
+        while (true) {
+            portENTER_CRITICAL(&request_lock);
+            TickType_t elapsed = xTaskGetTickCount() - request->submitted;
+            bool done = request->state == I2cRequestState::DONE;
+            bool expired = !done && elapsed >= request->timeout_ticks;
+            if (expired) request->state = I2cRequestState::ABANDONED;     // Released on the driver's completion
+            portEXIT_CRITICAL(&request_lock);
+
+            if (expired) return ESP_ERR_TIMEOUT;
+            if (!done) {
+                ulTaskNotifyTakeIndexed(NOTIFY_INDEX, pdTRUE, request->timeout_ticks - elapsed);
+                continue;
+            }
+
+            // Out of the driver's order, the slot is this task's until released
+            esp_err_t result = request->result;
+            if (result == ESP_OK && request->trans.read_size) {
+                memcpy(request->trans.read_buf, request->read_data, request->trans.read_size);
+            }
+            portENTER_CRITICAL(&request_lock);
+            requests.release(request);
+            portEXIT_CRITICAL(&request_lock);
+            return result;
+        }
     }
 
 } // namespace peripherals
@@ -1,10 +1,40 @@
 #pragma once
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/i2c_master.h"
 
 namespace peripherals {
+    // data: the read bytes, valid during the call only
+    using I2cDoneCallback = void (*)(esp_err_t result, const uint8_t *data, size_t size, void *arg);
+
+    // Write only, read only, or both: the write then the read after a repeated start, e.g. a register
+    // address followed by its data. The driver only works on the request's own buffers: write data is copied
+    // on submit, read data is copied to read_buf by wait() on the waiting task.
+    struct I2cTransaction {
+        const uint8_t *write_buf = nullptr;
+        size_t write_size = 0;
+        uint8_t *read_buf = nullptr;        // Unused with on_done
+        size_t read_size = 0;
+        int timeout_ms = 50;                // Bounds wait(); a request still in the driver RECLAIM_GRACE_MS later is reclaimed
+        I2cDoneCallback on_done = nullptr;  // From the I2C ISR, or a submitting task on reclaim; otherwise the submitter is notified
+        void *arg = nullptr;
+    };
+
+    struct I2cRequest;
+
+    // The bus runs in IDF async mode: transactions queue in the driver and complete from its ISR.
+    // The blocking calls submit and wait, so they return an error instead of hanging on a stuck bus.
     class I2C {
     public:
+        static constexpr uint8_t TRANS_QUEUE_DEPTH = 8;     // Per bus in the driver, also the request pool
+        static constexpr size_t MAX_WRITE = 16;             // Bytes per transaction
+        static constexpr size_t MAX_READ = 192;             // Bytes per transaction, a full MAX30102 FIFO
+        static constexpr uint8_t MAX_DEVICES = 4;
+        static constexpr UBaseType_t NOTIFY_INDEX = 1;      // Task notification for completions, 0 is left to sensor interrupts
+        static constexpr int REMOVE_WAIT_MS = 100;
+        static constexpr int RECLAIM_GRACE_MS = 200;        // Past the timeout: the device is wedged, its bus is reset
+
         I2C(i2c_port_num_t i2c_port_num, gpio_num_t sda_pin, gpio_num_t scl_pin);
         ~I2C();
 
@@ -14,15 +44,22 @@ namespace peripherals {
         void scan_dev_address(i2c_port_num_t i2c_port_num);
         void add_dev(i2c_port_num_t i2c_port_num, i2c_master_dev_handle_t *dev_handle, uint16_t device_address, uint32_t i2c_freq_hz);
         void remove_dev(i2c_master_dev_handle_t dev_handle);
-        void write_bytes(i2c_master_dev_handle_t dev_handle,
-                                    uint8_t *write_buf, size_t read_size);
-        void read_bytes(i2c_master_dev_handle_t dev_handle,
+        esp_err_t write_bytes(i2c_master_dev_handle_t dev_handle,
+                                    const uint8_t *write_buf, size_t write_size);
+        esp_err_t read_bytes(i2c_master_dev_handle_t dev_handle,
                                     uint8_t *read_buf, size_t read_size);
-        void write_read(i2c_master_dev_handle_t dev_handle,
-                        uint8_t *write_buf, size_t write_size,
+        esp_err_t write_read(i2c_master_dev_handle_t dev_handle,
+                        const uint8_t *write_buf, size_t write_size,
                         uint8_t *read_buf, size_t read_size);
 
+        // Queues the transaction and returns. Without on_done, request receives the handle to wait() on.
+        esp_err_t submit(i2c_master_dev_handle_t dev_handle, const I2cTransaction &trans, I2cRequest **request = nullptr);
+        // Blocks the submitting task until the request completes or its timeout passes, then releases it
+        esp_err_t wait(I2cRequest *request);
+
     private:
+        esp_err_t transfer(i2c_master_dev_handle_t dev_handle, const I2cTransaction &trans);
+
         i2c_port_num_t i2c_port_num_;
         gpio_num_t sda_pin_;
         gpio_num_t scl_pin_;
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace peripherals {
+    enum class I2cRequestState : uint8_t {
+        FREE = 0,
+        PENDING,
+        DONE,           // Finished, the waiting task has not collected it yet
+        ABANDONED,      // Its wait timed out, released when the driver finishes it
+        STALE           // Settled by reclaim, the driver may still use its buffers until it finishes it
+    };
+
+    // Request slots and, per device, the requests in the driver's order. The driver reports completions per
+    // device in submit order, so the oldest in-flight entry is the one that finished. A device whose oldest
+    // request is older than its timeout plus the grace is wedged: its entries are reclaimed once and settled
+    // by the caller, but stay in flight until the driver reports them, so no slot is reused while the
+    // driver can still write to it.
+    // No driver or RTOS calls, the caller holds its lock around every method. Request needs
+    // state, submitted and timeout_ticks.
+    template <typename Request, size_t SLOTS, size_t DEVICES>
+    class I2cQueue {
+    public:
+        int add_device(const void *dev) {
+            for (size_t i = 0; i < DEVICES; i++) {
+                if (!devices_[i].dev) {
+                    devices_[i] = {dev, {}, 0, 0, 0};
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        }
+
+        void remove_device(int device) { devices_[device].dev = nullptr; }
+
+        int find(const void *dev) const {
+            for (size_t i = 0; i < DEVICES; i++) {
+                if (dev && devices_[i].dev == dev) return static_cast<int>(i);
+            }
+            return -1;
+        }
+
+        // Free slot appended to the device's in-flight order, nullptr when the pool is used up
+        Request *acquire(int device, uint32_t now, uint32_t timeout_ticks) {
+            for (Request &slot : slots_) {
+                if (slot.state != I2cRequestState::FREE) continue;
+
+                slot.state = I2cRequestState::PENDING;
+                slot.submitted = now;
+                slot.timeout_ticks = timeout_ticks;
+                Device &d = devices_[device];
+                d.in_flight[(d.head + d.count) % SLOTS] = &slot;
+                d.count++;
+                return &slot;
+            }
+            return nullptr;
+        }
+
+        // The driver refused the newest request: no completion will come for it
+        void cancel(int device, Request *request) {
+            devices_[device].count--;
+            request->state = I2cRequestState::FREE;
+        }
+
+        // Request the driver just finished, nullptr when none is in flight. A STALE one only goes back to the pool.
+        Request *complete(int device) {
+            Device &d = devices_[device];
+            if (!d.count) return nullptr;
+
+            Request *request = d.in_flight[d.head];
+            d.head = (d.head + 1) % SLOTS;
+            d.count--;
+            if (d.stale) d.stale--;
+            return request;
+        }
+
+        // Reclaims the entries of wedged devices not reclaimed before; on_drop(device, request) settles each
+        // one and marks it STALE unless a task still waits on it. Returns the number of wedged devices.
+        template <typename F>
+        size_t reclaim(uint32_t now, uint32_t grace_ticks, F &&on_drop) {
+            size_t wedged = 0;
+            for (size_t i = 0; i < DEVICES; i++) {
+                Device &d = devices_[i];
+                if (!d.dev || d.stale == d.count) continue;
+
+                const Request *oldest = d.in_flight[(d.head + d.stale) % SLOTS];
+                if (now - oldest->submitted < oldest->timeout_ticks + grace_ticks) continue;
+
+                wedged++;
+                for (; d.stale < d.count; d.stale++) on_drop(static_cast<int>(i), d.in_flight[(d.head + d.stale) % SLOTS]);
+            }
+            return wedged;
+        }
+
+        void release(Request *request) { request->state = I2cRequestState::FREE; }
+
+        size_t in_flight(int device) const { return devices_[device].count; }
+        size_t stale(int device) const { return devices_[device].stale; }
+
+    private:
+        struct Device {
+            const void *dev;
+            Request *in_flight[SLOTS];
+            uint8_t head;
+            uint8_t count;
+            uint8_t stale;              // Reclaimed entries at the head, the driver has yet to report them
+        };
+
+        Request slots_[SLOTS] = {};
+        Device devices_[DEVICES] = {};
+
+    }; // class I2cQueue
+
+} // namespace peripherals
@@ -0,0 +1,65 @@
+#include "fall_alert.h"
+#include <cstdio>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "core/info.h"
+#include "common/config.h"
+
+static const char *TAG = "Fall alert";
+
+using json = nlohmann::json;
+
+namespace protocols {
+    FallAlert::FallAlert(MQTT *mqtt) : mqtt_(mqtt) {}
+
+    FallAlert::~FallAlert() {
+        if (task_) vTaskDelete(task_);
+        if (queue_) vQueueDelete(queue_);
+    }
+
+    void FallAlert::init() {
+        queue_ = xQueueCreate(QUEUE_ALERTS, sizeof(FallAlertMessage));
+    }
+
+    void FallAlert::start(BaseType_t core_id) {
+        init();
+
+        xTaskCreatePinnedToCore([](void *arg) { static_cast<FallAlert *>(arg)->start_task(arg); },
+            "Fall alert task", 1024 * 4, this, TASK_PRIORITY, &task_, core_id
+        );
+    }
+
+    void FallAlert::start_task(void *pvParameters) {
+        FallAlertMessage alert;
+        char value[16];
+
+        while (true) {
+            if (xQueueReceive(queue_, &alert, portMAX_DELAY) != pdTRUE) continue;
+
+            json data;
+            data[ID] = p_info.id;
+            snprintf(value, sizeof(value), "%.1f", alert.impact_g);
+            data[ALERT_IMPACT] = value;
+            data[ALERT_FREE_FALL] = std::to_string(alert.free_fall_ms);
+            data[ALERT_DETECT_MS] = std::to_string((alert.detected_us - alert.impact_us) / 1000);
+            std::string mess = data.dump();
+
+            // Also while disconnected: QoS 1 messages wait in the client outbox until the next connection
+            int msg_id = mqtt_->publish_priority(TOPIC_CENTER_ALERT, mess.c_str(), alert.detected_us);
+            int64_t latency = esp_timer_get_time() - alert.detected_us;
+            last_latency_us_.store(latency, std::memory_order_relaxed);
+            if (latency > max_latency_us_.load(std::memory_order_relaxed)) max_latency_us_.store(latency, std::memory_order_relaxed);
+
+            ESP_LOGW(TAG, "Fall alert msg %d, impact %.1f g, detection to publish %" PRId64 " us%s", msg_id, alert.impact_g,
+                latency, mqtt_->is_connected_ ? "" : " (queued, disconnected)");
+        }
+    }
+
+    bool FallAlert::raise(const FallAlertMessage &alert) {
+        return queue_ && xQueueSend(queue_, &alert, 0) == pdTRUE;
+    }
+
+} // namespace protocols
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "mqtt.h"
+
+namespace protocols {
+    struct FallAlertMessage {
+        int64_t detected_us;        // esp_timer time the sensor task confirmed the fall
+        int64_t impact_us;          // esp_timer time of the impact
+        float impact_g;
+        uint16_t free_fall_ms;
+    };
+
+    // Fall alerts on TOPIC_CENTER_ALERT with QoS 1, ahead of all other traffic. The sensor task hands alerts over
+    // without waiting; a task above every telemetry publisher sends them through MQTT::publish_priority, which
+    // holds telemetry back until the broker acknowledges. Detection to publish latency is logged per alert.
+    class FallAlert {
+    public:
+        static constexpr size_t QUEUE_ALERTS = 2;
+        static constexpr UBaseType_t TASK_PRIORITY = 6;         // Above MQTT (3), sensors (2) and the main loop
+
+        explicit FallAlert(MQTT *mqtt);
+        ~FallAlert();
+
+        void init();
+        void start(BaseType_t core_id = 0);
+
+        void start_task(void *pvParameters);
+        bool raise(const FallAlertMessage &alert);             // Any task, never waits
+        int64_t last_latency_us() const { return last_latency_us_.load(std::memory_order_relaxed); }
+        int64_t max_latency_us() const { return max_latency_us_.load(std::memory_order_relaxed); }
+
+    private:
+        MQTT *mqtt_;
+        QueueHandle_t queue_ = nullptr;
+        TaskHandle_t task_ = nullptr;
+        std::atomic<int64_t> last_latency_us_{-1};      // Detection to publish call return, -1 before the first alert
+        std::atomic<int64_t> max_latency_us_{-1};
+
+    }; // class FallAlert
+
+} // namespace protocols
@@ -1,5 +1,6 @@
 #include "mqtt.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "core/event_manager.h"
 #include <nlohmann/json.hpp>
@@ -55,6 +56,7 @@ namespace protocols {
             break;
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            mqtt->on_published(event->msg_id);
             break;
         case MQTT_EVENT_DATA:
             ESP_LOGI(TAG, "MQTT_EVENT_DATA");
@@ -126,12 +128,47 @@ namespace protocols {
         esp_mqtt_client_subscribe(client_, TOPIC_CLIENT_INFO, 0);
         esp_mqtt_client_subscribe(client_, TOPIC_CLIENT_NOTICE, 0);
         esp_mqtt_client_subscribe(client_, TOPIC_CLIENT_OTA, 0);
+        esp_mqtt_client_subscribe(client_, TOPIC_CLIENT_WAVEFORM, 0);
+        esp_mqtt_client_subscribe(client_, TOPIC_CLIENT_CALIBRATE, 0);
     }
 
     int MQTT::publish(const char *topic, const char *data) {
+        if (telemetry_held()) return -1;
         return esp_mqtt_client_publish(client_, topic, data, strlen(data), 0, 0);
     }
 
+    int MQTT::publish(const char *topic, const uint8_t *data, size_t size) {
+        if (telemetry_held()) return -1;
+        return esp_mqtt_client_publish(client_, topic, reinterpret_cast<const char *>(data), size, 0, 0);
+    }
+
+    int MQTT::publish_priority(const char *topic, const char *data, int64_t origin_us) {
+        // Held before the publish so no telemetry slips in between
+        priority_origin_us_.store(origin_us, std::memory_order_relaxed);
+        priority_hold_until_us_.store(esp_timer_get_time() + PRIORITY_HOLD_MS * 1000, std::memory_order_release);
+
+        int msg_id = esp_mqtt_client_publish(client_, topic, data, strlen(data), 1, 0);
+        priority_msg_id_.store(msg_id, std::memory_order_release);
+        if (msg_id < 0) priority_hold_until_us_.store(0, std::memory_order_relaxed);
+        return msg_id;
+    }
+
+    bool MQTT::telemetry_held() {
+        int64_t until = priority_hold_until_us_.load(std::memory_order_acquire);
+        return until && esp_timer_get_time() < until;
+    }
+
+    // MQTT task: PUBACK of a QoS 1 message
+    void MQTT::on_published(int msg_id) {
+        if (msg_id != priority_msg_id_.load(std::memory_order_acquire)) return;
+
+        int64_t latency = esp_timer_get_time() - priority_origin_us_.load(std::memory_order_relaxed);
+        priority_ack_latency_us_.store(latency, std::memory_order_relaxed);
+        priority_msg_id_.store(-1, std::memory_order_relaxed);
+        priority_hold_until_us_.store(0, std::memory_order_release);
+        ESP_LOGW(TAG, "Priority msg_id=%d acknowledged %" PRId64 " us after its event", msg_id, latency);
+    }
+
     void MQTT::on_data(void *event_data) {
         esp_mqtt_event_handle_t event = reinterpret_cast<esp_mqtt_event_handle_t>(event_data);
         esp_mqtt_client_handle_t client = event->client;
@@ -165,6 +202,14 @@ namespace protocols {
             static std::string url = data[URL];
 
             ev_mqtt.publish(EventID::OTA, &url);
+        } else if (strncmp(event->topic, TOPIC_CLIENT_WAVEFORM, event->topic_len) == 0) {
+            std::string data_str(event->data, event->data_len);
+            data = json::parse(data_str);
+            int enable = std::stoi(data[ENABLE].get<std::string>());
+
+            ev_mqtt.publish_intr(EventID::WAVEFORM, enable);
+        } else if (strncmp(event->topic, TOPIC_CLIENT_CALIBRATE, event->topic_len) == 0) {
+            ev_mqtt.publish_intr(EventID::IMU_CALIBRATE);
         }
     }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include "mqtt_client.h"
 
@@ -17,15 +18,31 @@ namespace protocols {
 
         void start_task(void *pvParameters);
         void subscribe_list();
+        // Telemetry, QoS 0: dropped (-1) while a priority message waits for its acknowledgement
         int publish(const char *topic, const char *data);
+        int publish(const char *topic, const uint8_t *data, size_t size);
+        // QoS 1 alert, holds telemetry back until the PUBACK or PRIORITY_HOLD_MS. origin_us: esp_timer time
+        // of the event behind it, for the acknowledgement latency.
+        int publish_priority(const char *topic, const char *data, int64_t origin_us);
+        int64_t priority_ack_latency_us() const { return priority_ack_latency_us_.load(std::memory_order_relaxed); }
         void on_data(void *event_data);
+        void on_published(int msg_id);
         void info_pub();
 
     private:
+        static constexpr int64_t PRIORITY_HOLD_MS = 2000;
+
+        bool telemetry_held();
+
         std::string server_address_;
         uint32_t port_;
         esp_mqtt_transport_t transport_;
 
+        std::atomic<int> priority_msg_id_{-1};
+        std::atomic<int64_t> priority_origin_us_{0};
+        std::atomic<int64_t> priority_hold_until_us_{0};       // 0: nothing in flight
+        std::atomic<int64_t> priority_ack_latency_us_{-1};
+
     }; // class MQTT
 
 } // namespace protocols
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace protocols {
+    // Binary raw-PPG frame, all fields little-endian:
+    //   0  u8   version (1)
+    //   1  u8   channels (2: red, IR)
+    //   2  u16  sample count
+    //   4  u32  sequence number, +1 per frame, gaps mean dropped frames
+    //   8  i64  time of the first sample, us (esp_timer)
+    //   16 u32  sample period, us
+    //   20 ...  per sample red then IR: zig-zag varint of the difference to the previous value of the channel,
+    //           the first sample of a frame is relative to 0 so every frame decodes on its own
+    struct WaveformFrame {
+        static constexpr uint8_t VERSION = 1;
+        static constexpr uint8_t CHANNELS = 2;
+        static constexpr size_t SAMPLES = 50;               // Most per frame: 1 s at 50 sps (HIGH_RESOLUTION)
+        static constexpr uint32_t FRAME_US = 1000000;       // Frame length, 12 samples at 12.5 sps
+        static constexpr size_t HEADER_BYTES = 20;
+        static constexpr size_t MAX_VARINT_BYTES = 3;       // 18-bit samples: deltas fit 19 bits after zig-zag
+        static constexpr size_t MAX_BYTES = HEADER_BYTES + SAMPLES * CHANNELS * MAX_VARINT_BYTES;
+
+        uint16_t size;
+        uint8_t data[MAX_BYTES];
+    };
+
+    // Builds WaveformFrames sample by sample, no allocation. A frame holds FRAME_US of samples at the
+    // post-averaging rate, so every profile publishes about once per second.
+    class WaveformEncoder {
+    public:
+        // True when this sample completed a frame, which stays in frame() until the next push
+        bool push(uint32_t red, uint32_t ir, int64_t time_us, uint32_t sample_period_us) {
+            if (count_ && sample_period_us != period_us_) restart();
+            if (!count_) begin(time_us, sample_period_us);
+
+            put_delta(red, prev_[0]);
+            put_delta(ir, prev_[1]);
+            if (++count_ < frame_samples_) return false;
+
+            finish();
+            return true;
+        }
+
+        // Drop the partial frame, the next sample starts a new one
+        void restart() { count_ = 0; }
+
+        const WaveformFrame &frame() const { return frame_; }
+        uint32_t sequence() const { return seq_; }
+
+        static uint32_t zigzag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+        static int32_t unzigzag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+        // Inverse of the encoder for tools and tests; false on a malformed frame
+        template <typename F>
+        static bool decode(const uint8_t *data, size_t size, F &&on_sample) {
+            if (size < WaveformFrame::HEADER_BYTES || data[0] != WaveformFrame::VERSION || data[1] != WaveformFrame::CHANNELS) return false;
+
+            uint16_t count = static_cast<uint16_t>(get_le(data + 2, 2));
+            int64_t start_us = static_cast<int64_t>(get_le(data + 8, 8));
+            uint32_t period_us = static_cast<uint32_t>(get_le(data + 16, 4));
+
+            size_t pos = WaveformFrame::HEADER_BYTES;
+            int32_t prev[WaveformFrame::CHANNELS] = {};
+            for (uint16_t i = 0; i < count; i++) {
+                uint32_t values[WaveformFrame::CHANNELS];
+                for (size_t c = 0; c < WaveformFrame::CHANNELS; c++) {
+                    uint32_t v = 0;
+                    int shift = 0;
+                    do {
+                        if (pos >= size || shift > 28) return false;
+                        v |= static_cast<uint32_t>(data[pos] & 0x7F) << shift;
+                        shift += 7;
+                    } while (data[pos++] & 0x80);
+                    prev[c] += unzigzag(v);
+                    values[c] = static_cast<uint32_t>(prev[c]);
+                }
+                on_sample(start_us + int64_t(i) * period_us, values[0], values[1]);
+            }
+            return pos == size;
+        }
+
+    private:
+        void begin(int64_t time_us, uint32_t sample_period_us) {
+            period_us_ = sample_period_us;
+            size_t samples = sample_period_us ? WaveformFrame::FRAME_US / sample_period_us : WaveformFrame::SAMPLES;
+            frame_samples_ = static_cast<uint16_t>(samples < 1 ? 1 : samples > WaveformFrame::SAMPLES ? WaveformFrame::SAMPLES : samples);
+            prev_[0] = prev_[1] = 0;
+
+            frame_.data[0] = WaveformFrame::VERSION;
+            frame_.data[1] = WaveformFrame::CHANNELS;
+            put_le(frame_.data + 4, seq_++, 4);
+            put_le(frame_.data + 8, static_cast<uint64_t>(time_us), 8);
+            put_le(frame_.data + 16, sample_period_us, 4);
+            frame_.size = WaveformFrame::HEADER_BYTES;
+        }
+
+        void finish() {
+            put_le(frame_.data + 2, count_, 2);
+            count_ = 0;
+        }
+
+        void put_delta(uint32_t value, uint32_t &prev) {
+            uint32_t v = zigzag(static_cast<int32_t>(value - prev));
+            prev = value;
+            while (v >= 0x80) {
+                frame_.data[frame_.size++] = static_cast<uint8_t>(v | 0x80);
+                v >>= 7;
+            }
+            frame_.data[frame_.size++] = static_cast<uint8_t>(v);
+        }
+
+        static void put_le(uint8_t *p, uint64_t v, size_t bytes) {
+            for (size_t i = 0; i < bytes; i++) p[i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+
+        static uint64_t get_le(const uint8_t *p, size_t bytes) {
+            uint64_t v = 0;
+            for (size_t i = 0; i < bytes; i++) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+            return v;
+        }
+
+        WaveformFrame frame_ = {};
+        uint32_t prev_[WaveformFrame::CHANNELS] = {};
+        uint32_t seq_ = 0;
+        uint32_t period_us_ = 0;
+        uint16_t count_ = 0;
+        uint16_t frame_samples_ = WaveformFrame::SAMPLES;
+
+    }; // class WaveformEncoder
+
+} // namespace protocols
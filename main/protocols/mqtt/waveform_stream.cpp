@@ -0,0 +1,69 @@
+#include "waveform_stream.h"
+#include <cstdio>
+#include "esp_log.h"
+#include "esp_mac.h"
+
+#include "core/event_manager.h"
+#include "common/config.h"
+
+static const char *TAG = "Waveform";
+
+using namespace core;
+
+namespace protocols {
+    auto &ev_waveform = EventManager::instance();
+
+    WaveformStream::WaveformStream(MQTT *mqtt) : mqtt_(mqtt) {}
+
+    WaveformStream::~WaveformStream() {
+        if (task_) vTaskDelete(task_);
+        if (queue_) vQueueDelete(queue_);
+    }
+
+    void WaveformStream::init() {
+        uint8_t mac[6];
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(topic_, sizeof(topic_), "%s%02x%02x%02x%02x%02x%02x", TOPIC_CENTER_WAVEFORM, MAC2STR(mac));
+
+        queue_ = xQueueCreate(QUEUE_FRAMES, sizeof(WaveformFrame));
+        ev_waveform.subscribe_intr(EventID::WAVEFORM, [this](int data) { this->set_enabled(data); });
+        ESP_LOGI(TAG, "Waveform topic %s", topic_);
+    }
+
+    void WaveformStream::start(BaseType_t core_id) {
+        init();
+
+        xTaskCreatePinnedToCore([](void *arg) { static_cast<WaveformStream *>(arg)->start_task(arg); },
+            "Waveform stream task", 1024 * 3, this, 1, &task_, core_id
+        );
+    }
+
+    void WaveformStream::start_task(void *pvParameters) {
+        static WaveformFrame frame;     // Too large for the task stack to spare
+
+        while (true) {
+            if (xQueueReceive(queue_, &frame, portMAX_DELAY) != pdTRUE) continue;
+            if (mqtt_->is_connected_) mqtt_->publish(topic_, frame.data, frame.size);
+        }
+    }
+
+    // Sensor task: at most one queue copy per frame, never waits
+    void WaveformStream::push(uint32_t red, uint32_t ir, int64_t time_us, uint32_t sample_period_us) {
+        bool enabled = enabled_.load(std::memory_order_relaxed);
+        if (enabled != was_enabled_) {
+            was_enabled_ = enabled;
+            encoder_.restart();
+        }
+        if (!enabled || !queue_) return;
+
+        if (encoder_.push(red, ir, time_us, sample_period_us) && xQueueSend(queue_, &encoder_.frame(), 0) != pdTRUE) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void WaveformStream::set_enabled(bool enabled) {
+        enabled_.store(enabled, std::memory_order_relaxed);
+        ESP_LOGI(TAG, "Waveform streaming %s", enabled ? "on" : "off");
+    }
+
+} // namespace protocols
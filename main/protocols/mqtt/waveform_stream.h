@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "mqtt.h"
+#include "waveform_frame.h"
+
+namespace protocols {
+    // Opt-in raw PPG streaming. The sensor task encodes samples in place and hands finished frames
+    // to a queue without waiting; a low priority task publishes them on TOPIC_CENTER_WAVEFORM<MAC>.
+    class WaveformStream {
+    public:
+        static constexpr size_t QUEUE_FRAMES = 4;           // 4 s of backlog before frames are dropped
+
+        explicit WaveformStream(MQTT *mqtt);
+        ~WaveformStream();
+
+        void init();
+        void start(BaseType_t core_id = 0);
+
+        void start_task(void *pvParameters);
+        void push(uint32_t red, uint32_t ir, int64_t time_us, uint32_t sample_period_us);
+        void set_enabled(bool enabled);
+        bool is_enabled() const { return enabled_.load(std::memory_order_relaxed); }
+        uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        MQTT *mqtt_;
+        QueueHandle_t queue_ = nullptr;
+        TaskHandle_t task_ = nullptr;
+        char topic_[48];
+
+        WaveformEncoder encoder_;           // Sensor task only
+        bool was_enabled_ = false;          // Sensor task only
+        std::atomic<bool> enabled_{false};
+        std::atomic<uint32_t> dropped_{0};
+
+    }; // class WaveformStream
+
+} // namespace protocols
@@ -0,0 +1,753 @@
+// Replays recorded MAX30102 red/IR traces through devices::PpgProcessor at full speed.
+//
+//   ppg_replay <trace.csv|trace.bin> [--ref ref.csv] [--engine windowed|streaming|spectral] [--profile low-power|standard|high-resolution]
+//              [--window-ms N] [--repeat N] [--no-motion]
+//   ppg_replay --bench
+//   ppg_replay --check
+//
+// trace.csv : "time_us,red,ir[,led_changed[,accel_x,accel_y,accel_z]]" or "red,ir" per line
+//             (time then advances by the profile sample period), accel is the mean over the sample interval in raw LSB
+// trace.bin : little-endian uint32_t red, uint32_t ir pairs
+// ref.csv   : "time_us,bpm,spo2" reference annotations, the latest one at or before each result is used
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#include "devices/max30102/ppg_processor.h"
+#include "common/sample_clock.h"
+#include "devices/mpu6050/activity.h"
+#include "devices/mpu6050/fall_detector.h"
+#include "devices/mpu6050/attitude.h"
+#include "devices/mpu6050/imu_calibration.h"
+#include "protocols/mqtt/waveform_frame.h"
+#include "peripherals/i2c_queue.h"
+
+using namespace devices;
+
+namespace {
+    struct Sample {
+        int64_t time_us;
+        uint32_t red;
+        uint32_t ir;
+        bool led_changed;
+        bool has_motion;
+        MotionRef motion;
+    };
+
+    struct Reference {
+        int64_t time_us;
+        float bpm;
+        float spo2;
+    };
+
+    struct ErrorStats {
+        double abs_sum = 0;
+        double sq_sum = 0;
+        size_t count = 0;
+
+        void add(double err) {
+            abs_sum += std::fabs(err);
+            sq_sum += err * err;
+            count++;
+        }
+
+        void print(const char *name) const {
+            if (!count) {
+                printf("%-6s no reference points\n", name);
+                return;
+            }
+            printf("%-6s MAE %.2f  RMSE %.2f  (%zu points)\n", name, abs_sum / count, std::sqrt(sq_sum / count), count);
+        }
+    };
+
+    bool ends_with(const std::string &s, const char *suffix) {
+        size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    std::vector<double> split_numbers(const std::string &line) {
+        std::vector<double> out;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) {
+            char *end = nullptr;
+            double v = strtod(field.c_str(), &end);
+            if (end == field.c_str()) return {};
+            out.push_back(v);
+        }
+        return out;
+    }
+
+    std::vector<Sample> load_trace(const std::string &path, int64_t sample_period_us) {
+        std::vector<Sample> samples;
+        int64_t t = 0;
+
+        if (ends_with(path, ".bin")) {
+            std::ifstream in(path, std::ios::binary);
+            uint32_t rec[2];
+            while (in.read(reinterpret_cast<char *>(rec), sizeof(rec))) {
+                samples.push_back({t, rec[0], rec[1], false, false, {}});
+                t += sample_period_us;
+            }
+            return samples;
+        }
+
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            auto v = split_numbers(line);
+            if (v.size() >= 3) {
+                Sample s = {static_cast<int64_t>(v[0]), static_cast<uint32_t>(v[1]), static_cast<uint32_t>(v[2]), v.size() > 3 && v[3] != 0,
+                            v.size() >= 7, {}};
+                if (s.has_motion) s.motion = {{static_cast<float>(v[4]), static_cast<float>(v[5]), static_cast<float>(v[6])}};
+                samples.push_back(s);
+            } else if (v.size() == 2) {
+                samples.push_back({t, static_cast<uint32_t>(v[0]), static_cast<uint32_t>(v[1]), false, false, {}});
+                t += sample_period_us;
+            }
+        }
+        return samples;
+    }
+
+    std::vector<Reference> load_reference(const std::string &path) {
+        std::vector<Reference> refs;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            auto v = split_numbers(line);
+            if (v.size() >= 3) refs.push_back({static_cast<int64_t>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2])});
+        }
+        std::sort(refs.begin(), refs.end(), [](const Reference &a, const Reference &b) { return a.time_us < b.time_us; });
+        return refs;
+    }
+
+    const Reference *reference_at(const std::vector<Reference> &refs, int64_t time_us) {
+        auto it = std::upper_bound(refs.begin(), refs.end(), time_us, [](int64_t t, const Reference &r) { return t < r.time_us; });
+        return it == refs.begin() ? nullptr : &*(it - 1);
+    }
+
+    template <typename F>
+    double ns_per_call(int calls, F &&f) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++) f(i);
+        std::chrono::duration<double, std::nano> dt = std::chrono::steady_clock::now() - start;
+        return dt.count() / calls;
+    }
+
+    // Float vs fixed-point variants of the same templated code paths
+    int run_bench() {
+        constexpr int CALLS = 2000000;
+        volatile float float_sink = 0;
+        volatile int32_t fixed_sink = 0;
+
+        constexpr auto &PPG_BANDPASS = PpgPipeline<AcquisitionProfile::STANDARD>::PPG_BANDPASS;
+        BiquadCascade<float, PPG_BANDPASS.size()> float_filter(PPG_BANDPASS);
+        BiquadCascade<int32_t, PPG_BANDPASS.size()> fixed_filter(PPG_BANDPASS);
+        printf("band-pass     float %6.1f ns/sample   fixed %6.1f ns/sample\n",
+            ns_per_call(CALLS, [&](int i) { float_sink = float_filter.process(static_cast<float>((100000 + (i & 0xFF)) << 4)); }),
+            ns_per_call(CALLS, [&](int i) { fixed_sink = fixed_filter.process((100000 + (i & 0xFF)) << 4); }));
+
+        Spo2Ratio<float> float_ratio(100000ULL * 125 << 4, 90000ULL * 125 << 4, 125);
+        Spo2Ratio<Q24> fixed_ratio(100000ULL * 125 << 4, 90000ULL * 125 << 4, 125);
+        printf("spo2 per beat float %6.1f ns/beat     fixed %6.1f ns/beat\n",
+            ns_per_call(CALLS, [&](int i) { float_sink = Spo2Ratio<float>::spo2(float_ratio.ratio(2000 + (i & 0x3FF), 3000)); }),
+            ns_per_call(CALLS, [&](int i) { fixed_sink = Spo2Ratio<Q24>::spo2(fixed_ratio.ratio(2000 + (i & 0x3FF), 3000)).raw(); }));
+
+        MotionCanceller<ProfileTraits<AcquisitionProfile::HIGH_RESOLUTION>::MOTION_TAPS> canceller(PPG_BANDPASS);
+        printf("motion NLMS   %6.1f ns/sample (%zu weights per channel)\n",
+            ns_per_call(CALLS, [&](int i) {
+                float accel[3] = {static_cast<float>(i & 0x3FF), 0, 2048};
+                int32_t red = (i & 0xFF) << 4, ir = (i & 0x7F) << 4;
+                canceller.process(red, ir, accel);
+                fixed_sink = red + ir;
+            }), canceller.WEIGHTS);
+
+        // A window's worth of per-beat SpO2 values: selection on the stack vs copy-and-sort on the heap
+        constexpr size_t BEATS = 16;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> spo2_dist(85.0f, 101.0f);
+        float beats[BEATS];
+        for (auto &v : beats) v = spo2_dist(rng);
+        printf("spo2 window   trimmed %6.1f ns   median %6.1f ns   vector sort %6.1f ns (%zu beats)\n",
+            ns_per_call(CALLS / 10, [&](int i) {
+                common::BoundedSample<float, 64> sample;
+                for (size_t k = 0; k < BEATS; k++) sample.push(beats[(k + i) % BEATS]);
+                float_sink = sample.trimmed_mean(0.25f);
+            }),
+            ns_per_call(CALLS / 10, [&](int i) {
+                common::BoundedSample<float, 64> sample;
+                for (size_t k = 0; k < BEATS; k++) sample.push(beats[(k + i) % BEATS]);
+                float_sink = sample.median();
+            }),
+            ns_per_call(CALLS / 10, [&](int i) {
+                std::vector<float> sample;
+                for (size_t k = 0; k < BEATS; k++) sample.push_back(beats[(k + i) % BEATS]);
+                std::sort(sample.begin(), sample.end());
+                float_sink = sample[BEATS / 2];
+            }), BEATS);
+
+        // One STANDARD window through the spectral engine
+        constexpr size_t SPECTRAL_SIZE = ProfileTraits<AcquisitionProfile::STANDARD>::SPECTRAL_SIZE;
+        constexpr size_t WINDOW_SAMPLES = 125;
+        static float fft_data[SPECTRAL_SIZE];
+        static SpectralHr<SPECTRAL_SIZE, 1> spectral;
+        float window[WINDOW_SAMPLES];
+        for (size_t i = 0; i < WINDOW_SAMPLES; i++) window[i] = std::sin(2 * M_PI * 1.2 * i / 12.5) * 1000 + spo2_dist(rng);
+        printf("spectral      FFT %zu %6.1f us   window estimate %6.1f us (%zu samples)\n", SPECTRAL_SIZE,
+            ns_per_call(CALLS / 1000, [&](int i) {
+                for (size_t k = 0; k < SPECTRAL_SIZE; k++) fft_data[k] = static_cast<float>((k * 7 + i) & 0xFF);
+                RealFft<SPECTRAL_SIZE>::forward(fft_data);
+                float_sink = fft_data[2];
+            }) / 1000,
+            ns_per_call(CALLS / 1000, [&](int) {
+                fixed_sink = spectral.estimate(std::span<const float>(window), 12.5f);
+            }) / 1000, WINDOW_SAMPLES);
+
+        AttitudeEstimator attitude;
+        printf("attitude      %6.1f ns/sample\n", ns_per_call(CALLS, [&](int i) {
+            const int16_t accel[3] = {static_cast<int16_t>(i & 0x3F), 100, 2048};
+            const int16_t gyro[3] = {static_cast<int16_t>(i & 0x1F), -3, 5};
+            float_sink = attitude.update(5000LL * (i + 1), accel, gyro).tilt;
+        }));
+
+        (void)float_sink;
+        (void)fixed_sink;
+        return 0;
+    }
+
+    // RealFft against a direct DFT in double precision, error relative to the largest bin
+    template <size_t N>
+    bool check_fft(std::mt19937 &rng) {
+        std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+        float data[N];
+        for (auto &v : data) v = dist(rng);
+        double in[N];
+        std::copy(data, data + N, in);
+        RealFft<N>::forward(data);
+
+        double max_err = 0, max_mag = 0;
+        for (size_t k = 0; k <= N / 2; k++) {
+            double re = 0, im = 0;
+            for (size_t n = 0; n < N; n++) {
+                re += in[n] * std::cos(2 * M_PI * k * n / N);
+                im -= in[n] * std::sin(2 * M_PI * k * n / N);
+            }
+            double got_re = k == 0 ? data[0] : k == N / 2 ? data[1] : data[2 * k];
+            double got_im = k == 0 || k == N / 2 ? 0 : data[2 * k + 1];
+            max_err = std::max(max_err, std::hypot(got_re - re, got_im - im));
+            max_mag = std::max(max_mag, std::hypot(re, im));
+        }
+        bool ok = max_err <= 1e-5 * max_mag * std::log2(N);
+        if (!ok) printf("check failed: RealFft<%zu> error %.3g of %.3g\n", N, max_err, max_mag);
+        return ok;
+    }
+
+    // SampleClock on a simulated sensor 0.8 % slower than nominal: ISR latency of 20 - 300 us with rare 5 ms
+    // outliers, 17-sample almost-full batches, one overflow. Returns the worst time error after settling, us.
+    int64_t check_sample_clock(std::mt19937 &rng, bool &monotonic) {
+        constexpr int64_t NOMINAL_US = 20000;
+        constexpr double ACTUAL_US = NOMINAL_US * 1.008;
+        constexpr size_t BATCH = 17;
+        std::uniform_int_distribution<int64_t> latency(20, 300);
+
+        common::SampleClock clock;
+        clock.restart(NOMINAL_US);
+        int64_t sample = 0, worst = 0, last = 0;
+        monotonic = true;
+        for (int batch = 0; batch < 2000; batch++) {
+            bool lost = batch == 1000;
+            if (lost) sample += 40;
+            int64_t isr = static_cast<int64_t>(1e6 + (sample + BATCH - 1) * ACTUAL_US) + (rng() % 200 ? latency(rng) : 5000);
+            clock.batch(isr, BATCH, BATCH - 1, lost);
+            for (size_t i = 0; i < BATCH; i++, sample++) {
+                int64_t t = clock.time(i);
+                if (batch && t <= last && !lost) monotonic = false;
+                last = t;
+                int64_t err = std::llabs(t - static_cast<int64_t>(1e6 + sample * ACTUAL_US));
+                if ((batch > 200 && batch < 1000) || batch > 1200) worst = std::max(worst, err);
+            }
+        }
+        return worst;
+    }
+
+    const char *activity_name(Activity activity) {
+        switch (activity) {
+            case Activity::WALK: return "walk";
+            case Activity::RUN: return "run";
+            default: return "rest";
+        }
+    }
+
+    // Synthetic wrist accelerometer at 100 Hz: a minute each of walking, rest with isolated jolts and running.
+    // Steps are half-sine bursts with cadence jitter on top of gravity and sensor noise.
+    bool check_activity(std::mt19937 &rng) {
+        struct Segment { float cadence_hz; float amplitude_g; Activity activity; };
+        constexpr Segment SEGMENTS[] = {{1.8f, 0.35f, Activity::WALK}, {0.1f, 0.6f, Activity::REST}, {2.8f, 1.0f, Activity::RUN}};
+        constexpr size_t COUNT = sizeof(SEGMENTS) / sizeof(SEGMENTS[0]);
+        constexpr int64_t PERIOD_US = 10000;
+        constexpr int64_t MINUTE_US = 60000000;
+        constexpr int64_t STEP_US = 150000;
+        constexpr float LSB = devices::ACCEL_LSB_PER_G;
+
+        devices::ActivityMonitor monitor;
+        std::normal_distribution<float> noise(0.0f, 0.03f);
+        std::uniform_real_distribution<float> jitter(0.95f, 1.05f);
+        uint32_t expected[COUNT] = {};
+        size_t reports = 0;
+        bool ok = true;
+        int64_t next_step = 200000, step_start = -STEP_US;
+
+        // One sample past the last minute closes it
+        for (int64_t t = 0; t <= static_cast<int64_t>(COUNT) * MINUTE_US; t += PERIOD_US) {
+            size_t index = std::min<size_t>(t / MINUTE_US, COUNT - 1);
+            const Segment &segment = SEGMENTS[index];
+            if (t >= next_step) {
+                step_start = t;
+                next_step = t + static_cast<int64_t>(1e6f / segment.cadence_hz * jitter(rng));
+                if (segment.activity != Activity::REST) expected[index]++;
+            }
+            float pulse = t - step_start < STEP_US ? segment.amplitude_g * std::sin(M_PI * (t - step_start) / STEP_US) : 0;
+            const int16_t accel[3] = {
+                static_cast<int16_t>(std::lround((0.3f + noise(rng)) * LSB)),
+                static_cast<int16_t>(std::lround((0.2f + noise(rng)) * LSB)),
+                static_cast<int16_t>(std::lround((0.93f + pulse + noise(rng)) * LSB))
+            };
+            if (!monitor.push(t, accel)) continue;
+
+            const auto &report = monitor.report();
+            size_t minute = std::min<size_t>((report.end_us - 1) / MINUTE_US, COUNT - 1);
+            uint32_t want = expected[minute];
+            bool good = report.activity == SEGMENTS[minute].activity && std::fabs(float(report.steps) - want) <= 0.05f * want + 1;
+            printf("activity        %-4s %3u steps (%3u), epochs %u/%u/%u, %s\n", activity_name(report.activity), report.steps,
+                want, report.epochs[0], report.epochs[1], report.epochs[2], good ? "ok" : "FAILED");
+            ok = ok && good;
+            reports++;
+        }
+        return ok && reports == COUNT;
+    }
+
+    // FallDetector on synthetic 100 Hz scenarios: real falls (a clean one, one with a slow slump into the impact)
+    // must be detected within a second of the impact; a jump, sitting down hard and a fall the wearer gets up from must not.
+    bool check_fall(std::mt19937 &rng) {
+        struct Phase { int64_t duration_us; float x_g, z_g; float gyro_dps; };
+        struct Scenario { const char *name; std::vector<Phase> phases; bool fall; };
+        const Scenario scenarios[] = {
+            {"fall", {{2000000, 0, 1, 0}, {350000, 0, 0.2f, 150}, {60000, 0, 4.5f, 400}, {250000, 0.8f, 0.9f, 120}, {3000000, 1, 0, 0}}, true},
+            {"slump fall", {{2000000, 0, 1, 0}, {400000, 0, 0.6f, 80}, {200000, 0, 0.35f, 200}, {40000, 0, 3.0f, 300}, {3000000, 0.7f, 0.7f, 0}}, true},
+            {"jump", {{2000000, 0, 1, 0}, {300000, 0, 0.1f, 20}, {80000, 0, 3.5f, 50}, {3000000, 0, 1, 0}, }, false},
+            {"sit down", {{2000000, 0, 1, 0}, {300000, 0, 0.7f, 40}, {60000, 0, 2.8f, 60}, {3000000, 0.7f, 0.7f, 0}}, false},
+            {"get up", {{2000000, 0, 1, 0}, {350000, 0, 0.2f, 150}, {60000, 0, 4.5f, 400}, {400000, 1, 0, 0}, {1500000, 0, 1.4f, 120}, {2000000, 0, 1, 0}}, false}
+        };
+        constexpr int64_t PERIOD_US = 10000;
+        constexpr float LSB = devices::ACCEL_LSB_PER_G;
+        std::normal_distribution<float> noise(0.0f, 0.03f);
+        bool ok = true;
+
+        for (const auto &scenario : scenarios) {
+            devices::FallDetector detector;
+            int64_t t = 0, impact_us = -1;
+            bool detected = false;
+            int64_t delay = 0;
+
+            for (const auto &phase : scenario.phases) {
+                if (phase.z_g >= 2.5f && impact_us < 0) impact_us = t;
+                for (int64_t end = t + phase.duration_us; t < end; t += PERIOD_US) {
+                    const int16_t accel[3] = {
+                        static_cast<int16_t>(std::lround((phase.x_g + noise(rng)) * LSB)),
+                        static_cast<int16_t>(std::lround(noise(rng) * LSB)),
+                        static_cast<int16_t>(std::lround((phase.z_g + noise(rng)) * LSB))
+                    };
+                    const int16_t gyro[3] = {static_cast<int16_t>(std::lround(phase.gyro_dps * devices::GYRO_LSB_PER_DPS)), 0, 0};
+                    if (detector.push(t, accel, gyro) && !detected) {
+                        detected = true;
+                        delay = t - impact_us;
+                    }
+                }
+            }
+
+            bool good = detected == scenario.fall && (!detected || delay <= 1000000);
+            if (detected) printf("fall            %-10s detected %lld ms after the impact, %s\n", scenario.name,
+                static_cast<long long>(delay / 1000), good ? "ok" : "FAILED");
+            else printf("fall            %-10s not detected, %s\n", scenario.name, good ? "ok" : "FAILED");
+            ok = ok && good;
+        }
+        return ok;
+    }
+
+    // AttitudeEstimator at 200 Hz against a simulated roll: 2 s level, a 90 deg roll at 45 deg/s with arm-swing
+    // accelerations on top, 3 s lying still. The gyro carries noise and a 2 deg/s bias on every axis.
+    bool check_attitude(std::mt19937 &rng) {
+        constexpr int64_t PERIOD_US = 5000;
+        constexpr float DEG = static_cast<float>(M_PI) / 180.0f;
+        std::normal_distribution<float> accel_noise(0.0f, 0.02f);
+        std::normal_distribution<float> gyro_noise(0.0f, 0.5f);
+        AttitudeEstimator estimator;
+        float worst = 0, roll = 0;
+        Posture postures[2] = {};
+
+        for (int64_t t = 0; t <= 7000000; t += PERIOD_US) {
+            float rate = t >= 2000000 && t < 4000000 ? 45.0f : 0;
+            roll += rate * PERIOD_US * 1e-6f;
+            float swing = rate > 0 ? 0.4f * std::sin(2 * M_PI * 2 * t * 1e-6) : 0;
+            const int16_t accel[3] = {
+                static_cast<int16_t>(std::lround((swing + accel_noise(rng)) * devices::ACCEL_LSB_PER_G)),
+                static_cast<int16_t>(std::lround((std::sin(roll * DEG) + accel_noise(rng)) * devices::ACCEL_LSB_PER_G)),
+                static_cast<int16_t>(std::lround((std::cos(roll * DEG) + accel_noise(rng)) * devices::ACCEL_LSB_PER_G))
+            };
+            const int16_t gyro[3] = {
+                static_cast<int16_t>(std::lround((rate + 2 + gyro_noise(rng)) * devices::GYRO_LSB_PER_DPS)),
+                static_cast<int16_t>(std::lround((2 + gyro_noise(rng)) * devices::GYRO_LSB_PER_DPS)),
+                static_cast<int16_t>(std::lround((2 + gyro_noise(rng)) * devices::GYRO_LSB_PER_DPS))
+            };
+            const Attitude &a = estimator.update(t, accel, gyro);
+            worst = std::max(worst, std::fabs(a.roll - roll) + std::fabs(a.pitch));
+            if (t == 1900000) postures[0] = a.posture;
+            if (t == 7000000) postures[1] = a.posture;
+        }
+
+        const Attitude &a = estimator.attitude();
+        bool ok = worst < 10.0f && std::fabs(a.roll - 90.0f) < 2.0f && std::fabs(a.tilt - 90.0f) < 2.0f &&
+                  postures[0] == Posture::UPRIGHT && postures[1] == Posture::LYING;
+        printf("attitude        worst error %.1f deg, final roll %.1f tilt %.1f, %s\n", worst, a.roll, a.tilt, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    // ImuCalibrator on a simulated part with gyro bias and a 3 % sensitivity error, tilted on a table.
+    // Stages: moving (no calibration), still (first calibration), small bias change (kept), 1.5 deg/s change (recalibrated).
+    bool check_calibration(std::mt19937 &rng) {
+        constexpr float LSB_G = devices::ACCEL_LSB_PER_G, LSB_DPS = devices::GYRO_LSB_PER_DPS;
+        std::normal_distribution<float> accel_noise(0.0f, 0.005f * LSB_G);
+        std::normal_distribution<float> gyro_noise(0.0f, 0.3f * LSB_DPS);
+        ImuCalibrator calibrator;
+        float bias[3] = {37, -12, 5};
+        int changes = 0;
+
+        auto run = [&](int samples, bool moving) {
+            for (int i = 0; i < samples; i++) {
+                float swing = moving ? 0.3f * std::sin(i * 0.3f) : 0;
+                const int16_t accel[3] = {
+                    static_cast<int16_t>(std::lround(1.03f * (0.5f + swing) * LSB_G + accel_noise(rng))),
+                    static_cast<int16_t>(std::lround(1.03f * 0.1f * LSB_G + accel_noise(rng))),
+                    static_cast<int16_t>(std::lround(1.03f * 0.8602f * LSB_G + accel_noise(rng)))
+                };
+                const int16_t gyro[3] = {
+                    static_cast<int16_t>(std::lround(bias[0] + (moving ? 80 * LSB_DPS * std::cos(i * 0.3f) : 0) + gyro_noise(rng))),
+                    static_cast<int16_t>(std::lround(bias[1] + gyro_noise(rng))),
+                    static_cast<int16_t>(std::lround(bias[2] + gyro_noise(rng)))
+                };
+                changes += calibrator.push(accel, gyro);
+            }
+        };
+
+        run(16 * ImuCalibrator::WINDOW_SAMPLES, true);
+        bool ok = changes == 0 && calibrator.needed();
+        run(ImuCalibrator::WINDOW_SAMPLES, false);
+        const ImuCalibration &cal = calibrator.calibration();
+        ok = ok && changes == 1 && !calibrator.needed() && std::fabs(cal.accel_scale * 1.03f - 1) < 0.005f;
+        for (int i = 0; i < 3; i++) ok = ok && std::abs(cal.gyro_offset[i] - bias[i]) <= 2;
+
+        bias[0] += 0.2f * LSB_DPS;
+        run(20 * ImuCalibrator::WINDOW_SAMPLES, false);
+        ok = ok && changes == 1;
+
+        bias[1] -= 1.5f * LSB_DPS;
+        run(ImuCalibrator::DRIFT_WINDOWS * ImuCalibrator::WINDOW_SAMPLES, false);
+        ok = ok && changes == 2 && std::abs(cal.gyro_offset[1] - bias[1]) <= 2;
+
+        ImuCalibrator reloaded;
+        ok = ok && reloaded.load(cal) && !reloaded.needed();
+        printf("calibration     gyro offset %d %d %d, accel scale %.4f, %d updates, %s\n", cal.gyro_offset[0], cal.gyro_offset[1],
+            cal.gyro_offset[2], cal.accel_scale, changes, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    // I2C request bookkeeping on a stuck bus: one device never completes, its timed-out requests must come
+    // back to the pool after the grace, and the driver's late completions for them must not shift the order
+    bool check_i2c_queue() {
+        using peripherals::I2cRequestState;
+        struct Request {
+            I2cRequestState state;
+            uint32_t submitted;
+            uint32_t timeout_ticks;
+        };
+        constexpr size_t SLOTS = 8;
+        constexpr uint32_t TIMEOUT = 6, GRACE = 20;
+        peripherals::I2cQueue<Request, SLOTS, 2> queue;
+        int stuck_dev = 1, healthy_dev = 2;
+        int stuck = queue.add_device(&stuck_dev), healthy = queue.add_device(&healthy_dev);
+
+        std::vector<Request *> hung;
+        for (size_t i = 0; i < SLOTS; i++) hung.push_back(queue.acquire(stuck, static_cast<uint32_t>(i), TIMEOUT));
+        bool ok = std::find(hung.begin(), hung.end(), nullptr) == hung.end() && !queue.acquire(healthy, SLOTS, TIMEOUT);
+
+        // Every wait times out, nothing completes; reclaimed entries turn STALE as in the driver
+        for (size_t i = 0; i < SLOTS; i += 2) hung[i]->state = I2cRequestState::ABANDONED;
+        size_t dropped = 0;
+        auto on_drop = [&](int, Request *request) {
+            request->state = I2cRequestState::STALE;
+            dropped++;
+        };
+        ok = ok && queue.reclaim(TIMEOUT + GRACE - 1, GRACE, on_drop) == 0 && dropped == 0;
+        ok = ok && queue.reclaim(TIMEOUT + GRACE, GRACE, on_drop) == 1 && dropped == SLOTS;
+        // Reclaimed once, and the driver may still write to them: no slot comes back before its completion
+        ok = ok && queue.reclaim(TIMEOUT + 10 * GRACE, GRACE, on_drop) == 0 && dropped == SLOTS;
+        ok = ok && queue.stale(stuck) == SLOTS && queue.in_flight(stuck) == SLOTS && !queue.acquire(healthy, 100, TIMEOUT);
+
+        // The bus recovers: each late completion frees its own slot, which the other device takes right away
+        // while the next stale completions are still due
+        size_t freed = 0;
+        for (size_t i = 0; i < SLOTS; i++) {
+            Request *late = queue.complete(stuck);
+            ok = ok && late == hung[i] && late->state == I2cRequestState::STALE;
+            if (late) queue.release(late);
+            freed += late != nullptr;
+
+            Request *reused = queue.acquire(healthy, 100 + static_cast<uint32_t>(i), TIMEOUT);
+            ok = ok && reused == hung[i] && !queue.acquire(healthy, 100, TIMEOUT);
+        }
+        ok = ok && queue.stale(stuck) == 0 && queue.in_flight(stuck) == 0 && queue.in_flight(healthy) == SLOTS;
+        for (size_t i = 0; i < SLOTS; i++) {
+            Request *request = queue.complete(healthy);
+            ok = ok && request == hung[i] && request->state == I2cRequestState::PENDING;
+            if (request) queue.release(request);
+        }
+
+        // The other device uses the whole pool again, and so does the recovered one
+        for (uint32_t t = 0; t < 100; t++) {
+            Request *request = queue.acquire(t & 1 ? stuck : healthy, 200 + t, TIMEOUT);
+            ok = ok && request && queue.complete(t & 1 ? stuck : healthy) == request;
+            if (request) queue.release(request);
+        }
+
+        printf("i2c queue       stuck bus: %zu requests reclaimed, %zu slots freed by late completions, %s\n", dropped, freed,
+            ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    // Property checks: order statistics against a full sort on random, duplicate-heavy and sorted inputs,
+    // the real FFT against a direct DFT, the sample clock against a simulated sensor,
+    // the pedometer, the fall detector, the attitude filter and the IMU calibration on synthetic motion
+    int run_check() {
+        constexpr size_t N = 64;
+        constexpr int ROUNDS = 20000;
+        std::mt19937 rng(7);
+        size_t failures = 0;
+
+        for (int round = 0; round < ROUNDS; round++) {
+            size_t count = 1 + rng() % (N + 8);         // Also past the capacity
+            int mode = round % 3;
+            common::BoundedSample<float, N> sample;
+            std::vector<float> kept;
+            for (size_t i = 0; i < count; i++) {
+                float v = mode == 0 ? std::uniform_real_distribution<float>(80.0f, 102.0f)(rng)
+                        : mode == 1 ? static_cast<float>(90 + rng() % 4)
+                        : static_cast<float>(i);
+                if (sample.push(v)) kept.push_back(v);
+            }
+            std::sort(kept.begin(), kept.end());
+
+            size_t n = kept.size();
+            float median = n & 1 ? kept[n / 2] : (kept[n / 2 - 1] + kept[n / 2]) / 2;
+            float trim = static_cast<float>(rng() % 50) / 100.0f;
+            size_t k = std::min(static_cast<size_t>(n * trim + 0.5f), (n - 1) / 2);
+            double sum = 0;
+            for (size_t i = k; i < n - k; i++) sum += kept[i];
+            float trimmed = static_cast<float>(sum / (n - 2 * k));
+
+            bool ok = sample.size() == n && sample.dropped() == count - n;
+            ok = ok && sample.median() == median;
+            ok = ok && std::fabs(sample.trimmed_mean(trim) - trimmed) <= 1e-4f * std::fabs(trimmed);
+            ok = ok && sample.median() == median;       // Queries reorder, results stay the same
+            if (!ok && failures++ < 10) printf("check failed: round %d, %zu values, trim %.2f\n", round, count, trim);
+        }
+
+        printf("bounded sample  %d rounds, %zu failures\n", ROUNDS, failures);
+
+        size_t fft_failures = 0;
+        for (int round = 0; round < 20; round++) {
+            fft_failures += !check_fft<4>(rng) + !check_fft<8>(rng) + !check_fft<64>(rng) + !check_fft<512>(rng);
+        }
+        printf("real fft        %d sizes x 20 rounds, %zu failures\n", 4, fft_failures);
+
+        bool monotonic;
+        int64_t clock_error = check_sample_clock(rng, monotonic);
+        bool clock_ok = monotonic && clock_error < 1000;
+        printf("sample clock    worst error %lld us after settling%s, %s\n", static_cast<long long>(clock_error),
+            monotonic ? "" : ", NOT MONOTONIC", clock_ok ? "ok" : "FAILED");
+
+        bool activity_ok = check_activity(rng);
+        bool fall_ok = check_fall(rng);
+        bool attitude_ok = check_attitude(rng);
+        bool calibration_ok = check_calibration(rng);
+        bool i2c_ok = check_i2c_queue();
+        return failures || fft_failures || !clock_ok || !activity_ok || !fall_ok || !attitude_ok || !calibration_ok || !i2c_ok ? 1 : 0;
+    }
+
+    // Raw waveform frames for the whole trace: size and a decode round trip
+    void waveform_report(const std::vector<Sample> &samples, int64_t sample_period_us) {
+        protocols::WaveformEncoder encoder;
+        size_t frames = 0, bytes = 0, next = 0, mismatches = 0, pairs = 0;
+
+        for (const auto &s : samples) {
+            if (!encoder.push(s.red, s.ir, s.time_us, static_cast<uint32_t>(sample_period_us))) continue;
+
+            const auto &frame = encoder.frame();
+            frames++;
+            bytes += frame.size;
+            pairs += frame.data[2] | (frame.data[3] << 8);
+            bool ok = protocols::WaveformEncoder::decode(frame.data, frame.size, [&](int64_t, uint32_t red, uint32_t ir) {
+                if (red != samples[next].red || ir != samples[next].ir) mismatches++;
+                next++;
+            });
+            if (!ok) mismatches++;
+        }
+        if (!frames) return;
+
+        double seconds = pairs * sample_period_us / 1e6;
+        printf("waveform    %zu frames, %.1f B/frame, %.0f B/s (%.2f B/sample pair), %s\n", frames, double(bytes) / frames,
+            bytes / seconds, double(bytes) / pairs, mismatches ? "ROUND TRIP FAILED" : "round trip ok");
+    }
+
+    const char *engine_name(HrEngine engine) {
+        switch (engine) {
+            case HrEngine::STREAMING: return "streaming";
+            case HrEngine::SPECTRAL: return "spectral";
+            default: return "windowed";
+        }
+    }
+
+    void usage() {
+        fprintf(stderr, "usage: ppg_replay <trace.csv|trace.bin> [--ref ref.csv] [--engine windowed|streaming|spectral] "
+                        "[--profile low-power|standard|high-resolution] [--window-ms N] [--repeat N] [--no-motion]\n"
+                        "       ppg_replay --bench\n"
+                        "       ppg_replay --check\n");
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string trace_path;
+    std::string ref_path;
+    HrEngine engine = HrEngine::WINDOWED;
+    AcquisitionProfile profile = AcquisitionProfile::STANDARD;
+    int64_t window_us = 0;
+    int repeat = 1;
+    bool use_motion = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--bench") return run_bench();
+        else if (arg == "--check") return run_check();
+        else if (arg == "--ref" && i + 1 < argc) ref_path = argv[++i];
+        else if (arg == "--engine" && i + 1 < argc) {
+            std::string name = argv[++i];
+            engine = name == "streaming" ? HrEngine::STREAMING : name == "spectral" ? HrEngine::SPECTRAL : HrEngine::WINDOWED;
+        }
+        else if (arg == "--profile" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == profile_name(AcquisitionProfile::LOW_POWER)) profile = AcquisitionProfile::LOW_POWER;
+            else if (name == profile_name(AcquisitionProfile::HIGH_RESOLUTION)) profile = AcquisitionProfile::HIGH_RESOLUTION;
+            else profile = AcquisitionProfile::STANDARD;
+        }
+        else if (arg == "--window-ms" && i + 1 < argc) window_us = atoll(argv[++i]) * 1000;
+        else if (arg == "--repeat" && i + 1 < argc) repeat = std::max(1, atoi(argv[++i]));
+        else if (arg == "--no-motion") use_motion = false;
+        else if (arg[0] != '-' && trace_path.empty()) trace_path = arg;
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (trace_path.empty()) {
+        usage();
+        return 1;
+    }
+
+    const ProfileConfig cfg = profile_config(profile);
+    if (!window_us) window_us = cfg.window_ms * 1000LL;
+
+    auto samples = load_trace(trace_path, cfg.sample_period_us);
+    auto refs = ref_path.empty() ? std::vector<Reference>{} : load_reference(ref_path);
+    if (samples.empty()) {
+        fprintf(stderr, "no samples in %s\n", trace_path.c_str());
+        return 1;
+    }
+
+    ErrorStats bpm_err;
+    ErrorStats spo2_err;
+    ErrorStats bpm_kept_err;
+    size_t results = 0;
+    size_t kept = 0;
+    size_t beats = 0;
+    size_t hrv_reports = 0;
+    size_t windows = 0;
+    std::chrono::duration<double, std::micro> caculate_time{0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        PpgProcessor ppg(profile, samples.front().time_us);
+        ppg.set_engine(engine);
+        int64_t window_end = samples.front().time_us + window_us;
+
+        for (const auto &s : samples) {
+            PpgEvent event = ppg.push(s.red, s.ir, s.time_us, s.led_changed, use_motion && s.has_motion ? &s.motion : nullptr);
+            if (event == PpgEvent::NO_FINGER) window_end = s.time_us + window_us;
+            else if (event == PpgEvent::BEAT) beats++;
+
+            if (s.time_us < window_end) continue;
+            window_end += window_us;
+            auto caculate_start = std::chrono::steady_clock::now();
+            bool done = ppg.caculate(s.time_us);
+            caculate_time += std::chrono::steady_clock::now() - caculate_start;
+            windows++;
+            if (!done || r) continue;
+
+            const SignalQualityReport &quality = ppg.get_quality();
+            bool keep = quality.score >= VITALS_QUALITY_MIN;
+            results++;
+            kept += keep;
+            if (const Reference *ref = reference_at(refs, s.time_us)) {
+                bpm_err.add(ppg.get_heart_rate() - ref->bpm);
+                spo2_err.add(ppg.get_spo2() - ref->spo2);
+                if (keep) bpm_kept_err.add(ppg.get_heart_rate() - ref->bpm);
+            }
+            printf("%10.3f s  bpm %3d  spo2 %6.2f  quality %3u (PI %.2f%%, cv %5.2f, clipped %u)%s\n", s.time_us / 1e6,
+                ppg.get_heart_rate(), ppg.get_spo2(), quality.score, quality.perfusion_index, quality.interval_cv, quality.clipped,
+                keep ? "" : "  suppressed");
+
+            const HrvReport &hrv = ppg.get_hrv();
+            if (hrv.end_us == s.time_us) {
+                hrv_reports++;
+                printf("%10.3f s  hrv  RMSSD %6.1f ms  SDNN %6.1f ms  pNN50 %5.1f%%  mean RR %6.1f ms (%u RR, %u rejected)\n",
+                    s.time_us / 1e6, hrv.rmssd, hrv.sdnn, hrv.pnn50, hrv.mean_rr, hrv.intervals, hrv.rejected);
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    rusage usage_info;
+    getrusage(RUSAGE_SELF, &usage_info);
+
+    printf("\nengine      %s, profile %s\n", engine_name(engine), profile_name(profile));
+    printf("samples     %zu x %d, %zu results, %zu beats\n", samples.size(), repeat, results, beats / repeat);
+    bpm_err.print("bpm");
+    spo2_err.print("spo2");
+    printf("quality     %zu of %zu results kept (score >= %d)\n", kept, results, VITALS_QUALITY_MIN);
+    if (windows) printf("caculate    %.1f us/window\n", caculate_time.count() / windows);
+    printf("hrv         %zu reports (%lld s periods)\n", hrv_reports, static_cast<long long>(PpgPipeline<AcquisitionProfile::STANDARD>::HRV_PERIOD_US / 1000000));
+    bpm_kept_err.print("kept");
+    printf("throughput  %.0f samples/s\n", samples.size() * repeat / elapsed.count());
+    waveform_report(samples, cfg.sample_period_us);
+    printf("memory      PpgProcessor %zu bytes, peak RSS %ld kB\n", sizeof(PpgProcessor), usage_info.ru_maxrss);
+    return 0;
+}